@@ -0,0 +1,161 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "openvr.h"
+#include "frametrace.h"
+#include "triplebuffer.h"
+
+// The poses the compositor handed out at the start of a frame
+struct PoseSnapshot
+{
+	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
+	// When WaitGetPoses returned, and when the poses are predicted for
+	std::chrono::steady_clock::time_point time;
+	std::chrono::steady_clock::time_point photonTime;
+	// Counts compositor frames from 1, 0 until the first one
+	uint64_t frame;
+};
+
+// What the game rendered for a frame
+struct FrameSubmission
+{
+	// PoseSnapshot::frame of the poses the frame was rendered with
+	uint64_t frame = 0;
+	// Only the Texture_t part is used without Submit_TextureWithPose
+	vr::VRTextureWithPose_t eyes[2] = {};
+	vr::VRTextureBounds_t bounds[2] = {};
+	bool hasBounds = false;
+	vr::EVRSubmitFlags flags = vr::Submit_Default;
+};
+
+// Waits for the compositor on its own thread, so the game's thread never blocks on it. The newest
+// poses are read without waiting through a triple buffer.
+//
+// The compositor expects exactly one Submit per frame, between WaitGetPoses calls. This thread
+// waits for a frame's poses, publishes them, and only calls WaitGetPoses again once the game
+// submitted for that frame. Submit stays on the game's render thread, which also draws into the
+// eye textures, so DXVK sees the textures' rendering and their submission on one queue in order,
+// like before this thread existed. The mutex orders the two threads, WaitGetPoses and Submit never
+// run at the same time.
+class CompositorSync
+{
+public:
+	// secondsToPhotons predicts how long until a frame started now is shown
+	CompositorSync(std::function<float()> secondsToPhotons)
+		: m_SecondsToPhotons(std::move(secondsToPhotons))
+	{
+		m_Thread = std::thread([this] { Run(); });
+	}
+
+	CompositorSync(const CompositorSync &) = delete;
+	CompositorSync &operator=(const CompositorSync &) = delete;
+
+	~CompositorSync()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Changed.notify_all();
+		m_Thread.join();
+	}
+
+	// Render thread. Submits a rendered frame if the compositor started one nothing was submitted
+	// for yet, otherwise drops it and returns false, the compositor only takes one per frame. Never
+	// waits for the compositor.
+	bool Submit(const FrameSubmission &submission)
+	{
+		uint64_t frame;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Submitted >= m_Started)
+			{
+				m_DroppedFrames.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			frame = m_Started;
+		}
+
+		// The game doesn't wait for a frame's poses, so it usually renders with the previous
+		// frame's, late latching and the pose submitted with the eyes cover that. Anything older
+		// means the game didn't pick up a snapshot it could have.
+		if (submission.frame + 1 < frame)
+			m_StaleSubmits.fetch_add(1, std::memory_order_relaxed);
+
+		{
+			FRAME_TRACE_SCOPE("Submit");
+			for (int eye = 0; eye < 2; ++eye)
+				vr::VRCompositor()->Submit((vr::EVREye)eye, &submission.eyes[eye], submission.hasBounds ? &submission.bounds[eye] : NULL, submission.flags);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Submitted = frame;
+		}
+		m_Changed.notify_all();
+		return true;
+	}
+
+	// Only one thread may read poses. Never blocks, returns the same snapshot until a newer one is published.
+	const PoseSnapshot &LatestPoses()
+	{
+		m_Poses.Update();
+		return m_Poses.Read();
+	}
+
+	// Frames that were submitted with poses from before the previous compositor frame
+	uint64_t StaleSubmits() const
+	{
+		return m_StaleSubmits.load(std::memory_order_relaxed);
+	}
+
+	// Rendered frames Submit dropped, because the compositor had no frame for them
+	uint64_t DroppedFrames() const
+	{
+		return m_DroppedFrames.load(std::memory_order_relaxed);
+	}
+
+private:
+	TripleBuffer<PoseSnapshot> m_Poses;
+	std::function<float()> m_SecondsToPhotons;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Changed;
+	// Last frame WaitGetPoses returned for, and the last frame the game submitted for
+	uint64_t m_Started = 0;
+	uint64_t m_Submitted = 0;
+	bool m_Stopping = false;
+
+	std::atomic<uint64_t> m_StaleSubmits{ 0 };
+	std::atomic<uint64_t> m_DroppedFrames{ 0 };
+
+	std::thread m_Thread;
+
+	void Run()
+	{
+		uint64_t frame = 0;
+		while (true)
+		{
+			PoseSnapshot &snapshot = m_Poses.WriteBuffer();
+			{
+				FRAME_TRACE_SCOPE("WaitGetPoses");
+				vr::VRCompositor()->WaitGetPoses(snapshot.poses, vr::k_unMaxTrackedDeviceCount, NULL, 0);
+			}
+			snapshot.time = std::chrono::steady_clock::now();
+			snapshot.photonTime = snapshot.time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(m_SecondsToPhotons()));
+			snapshot.frame = ++frame;
+			m_Poses.Publish();
+
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Started = frame;
+			m_Changed.wait(lock, [this, frame] { return m_Submitted >= frame || m_Stopping; });
+			if (m_Stopping)
+				return;
+		}
+	}
+};
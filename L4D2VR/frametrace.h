@@ -0,0 +1,220 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Timeline of named spans, exported as Chrome trace JSON for chrome://tracing or Perfetto.
+// Every thread records into its own ring buffer without locks, when a buffer is full the oldest
+// spans are overwritten. While recording is off a span costs one atomic load.
+namespace FrameTrace
+{
+	// Spans kept per thread, with ~10 spans a frame that's the last 18 seconds at 90 Hz
+	constexpr size_t Capacity = 1 << 14;
+
+	inline uint64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	struct Span
+	{
+		// Has to outlive the trace, normally a literal
+		const char *name;
+		uint64_t start;
+		uint64_t end;
+		int thread;
+	};
+
+	// Written by its thread only. Slots are atomics so the exporter can read them at any time,
+	// whatever it reads while the slot is overwritten is dropped.
+	class ThreadRing
+	{
+	public:
+		ThreadRing(int thread)
+			: m_Thread(thread), m_Slots(new Slot[Capacity])
+		{}
+
+		void Push(const char *name, uint64_t start, uint64_t end)
+		{
+			const uint64_t head = m_Head.load(std::memory_order_relaxed);
+			Slot &slot = m_Slots[head % Capacity];
+			slot.name.store(name, std::memory_order_relaxed);
+			slot.start.store(start, std::memory_order_relaxed);
+			slot.end.store(end, std::memory_order_relaxed);
+			m_Head.store(head + 1, std::memory_order_release);
+		}
+
+		void Read(std::vector<Span> &spans) const
+		{
+			const uint64_t head = m_Head.load(std::memory_order_acquire);
+			const uint64_t first = head > Capacity ? head - Capacity : 0;
+
+			std::vector<Span> read;
+			read.reserve((size_t)(head - first));
+			for (uint64_t i = first; i < head; ++i)
+			{
+				const Slot &slot = m_Slots[i % Capacity];
+				read.push_back({ slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed), m_Thread });
+			}
+
+			// The slot being written while head was read again, and everything before it, may be torn
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t after = m_Head.load(std::memory_order_relaxed);
+			const uint64_t valid = after >= Capacity ? after - Capacity + 1 : 0;
+			for (uint64_t i = first; i < head; ++i)
+			{
+				if (i >= valid)
+					spans.push_back(read[(size_t)(i - first)]);
+			}
+		}
+
+	private:
+		struct Slot
+		{
+			std::atomic<const char *> name{ nullptr };
+			std::atomic<uint64_t> start{ 0 };
+			std::atomic<uint64_t> end{ 0 };
+		};
+
+		int m_Thread;
+		std::unique_ptr<Slot[]> m_Slots;
+		std::atomic<uint64_t> m_Head{ 0 };
+	};
+
+	class Recorder
+	{
+	public:
+		static Recorder &Get()
+		{
+			static Recorder recorder;
+			return recorder;
+		}
+
+		bool IsEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+		// Spans recorded before are kept until they're overwritten
+		void SetEnabled(bool enabled)
+		{
+			if (enabled && !IsEnabled())
+				m_Since.store(Now(), std::memory_order_relaxed);
+			m_Enabled.store(enabled, std::memory_order_relaxed);
+		}
+
+		void Record(const char *name, uint64_t start, uint64_t end)
+		{
+			thread_local ThreadRing *ring = AddThread();
+			ring->Push(name, start, end);
+		}
+
+		// Every span still in the buffers since recording was last enabled, oldest first per thread
+		std::vector<Span> Collect()
+		{
+			std::vector<Span> spans;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				for (const std::unique_ptr<ThreadRing> &ring : m_Rings)
+					ring->Read(spans);
+			}
+
+			const uint64_t since = m_Since.load(std::memory_order_relaxed);
+			std::vector<Span> recent;
+			for (const Span &span : spans)
+			{
+				if (span.name && span.start >= since)
+					recent.push_back(span);
+			}
+			return recent;
+		}
+
+		std::string ExportJson()
+		{
+			return ToJson(Collect());
+		}
+
+		bool Export(const char *path)
+		{
+			std::ofstream file(path, std::ios::binary);
+			file << ExportJson();
+			return file.good();
+		}
+
+		// Complete ("X") events in microseconds, relative to the earliest span
+		static std::string ToJson(const std::vector<Span> &spans)
+		{
+			uint64_t origin = UINT64_MAX;
+			for (const Span &span : spans)
+				origin = span.start < origin ? span.start : origin;
+
+			// Nanosecond resolution however long the trace is
+			std::ostringstream json;
+			json << std::fixed << std::setprecision(3);
+			json << "{\"traceEvents\":[";
+			for (size_t i = 0; i < spans.size(); ++i)
+			{
+				const Span &span = spans[i];
+				json << (i ? ",\n" : "\n") << "{\"name\":\"";
+				for (const char *c = span.name; *c; ++c)
+				{
+					if (*c == '"' || *c == '\\')
+						json << '\\' << *c;
+					else if ((unsigned char)*c < 0x20)
+						json << "\\u00" << Hex[(*c >> 4) & 0xF] << Hex[*c & 0xF];
+					else
+						json << *c;
+				}
+				json << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread
+					<< ",\"ts\":" << (span.start - origin) / 1000.0
+					<< ",\"dur\":" << (span.end - span.start) / 1000.0 << "}";
+			}
+			json << "\n],\"displayTimeUnit\":\"ms\"}\n";
+			return json.str();
+		}
+
+	private:
+		static constexpr const char *Hex = "0123456789abcdef";
+
+		std::atomic<bool> m_Enabled{ false };
+		std::atomic<uint64_t> m_Since{ 0 };
+
+		std::mutex m_Mutex;
+		// Never freed, a thread's spans stay readable after it exits
+		std::vector<std::unique_ptr<ThreadRing>> m_Rings;
+
+		ThreadRing *AddThread()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Rings.push_back(std::make_unique<ThreadRing>((int)m_Rings.size() + 1));
+			return m_Rings.back().get();
+		}
+	};
+
+	// Records from construction to destruction, if recording was on when it started
+	class Scope
+	{
+	public:
+		Scope(const char *name)
+			: m_Name(Recorder::Get().IsEnabled() ? name : nullptr), m_Start(m_Name ? Now() : 0)
+		{}
+
+		~Scope()
+		{
+			if (m_Name)
+				Recorder::Get().Record(m_Name, m_Start, Now());
+		}
+
+	private:
+		const char *m_Name;
+		uint64_t m_Start;
+	};
+}
+
+#define FRAME_TRACE_CONCAT_(a, b) a##b
+#define FRAME_TRACE_CONCAT(a, b) FRAME_TRACE_CONCAT_(a, b)
+#define FRAME_TRACE_SCOPE(name) FrameTrace::Scope FRAME_TRACE_CONCAT(frameTraceScope, __LINE__)(name)
@@ -1,42 +1,93 @@
 #include "game.h"
 #include <Windows.h>
 #include <iostream>
+#include <stdexcept>
 #include "sdk.h"
 #include "vr.h"
 #include "hooks.h"
 #include "offsets.h"
 #include "sigscanner.h"
+#include "readiness.h"
+#include "taskgraph.h"
+#include "threadpool.h"
 
 Game::Game()
 {
-    while (!(m_BaseClient = (uintptr_t)GetModuleHandle("client.dll")))
-        Sleep(50);
-    while (!(m_BaseEngine = (uintptr_t)GetModuleHandle("engine.dll")))
-        Sleep(50);
-    while (!(m_BaseMaterialSystem = (uintptr_t)GetModuleHandle("materialsystem.dll")))
-        Sleep(50);
-    while (!(m_BaseServer = (uintptr_t)GetModuleHandle("server.dll")))
-        Sleep(50);
-    while (!(m_BaseVgui2 = (uintptr_t)GetModuleHandle("vgui2.dll")))
-        Sleep(50);
-
-    m_ClientEntityList = (IClientEntityList *)GetInterface("client.dll", "VClientEntityList003");
-    m_EngineTrace = (IEngineTrace *)GetInterface("engine.dll", "EngineTraceClient004");
-    m_EngineClient = (IEngineClient *)GetInterface("engine.dll", "VEngineClient015");
-    m_MaterialSystem = (IMaterialSystem *)GetInterface("MaterialSystem.dll", "VMaterialSystem080");
-    m_ClientViewRender = (IViewRender *)GetInterface("client.dll", "VEngineRenderView013");
-    m_EngineViewRender = (IViewRender *)GetInterface("engine.dll", "VEngineRenderView013");
-    m_ModelInfo = (IModelInfo *)GetInterface("engine.dll", "VModelInfoClient004");
-    m_ModelRender = (IModelRender *)GetInterface("engine.dll", "VEngineModel016");
-    m_VguiInput = (IInput *)GetInterface("vgui2.dll", "VGUI_InputInternal001");
-    m_VguiSurface = (ISurface *)GetInterface("vguimatsurface.dll", "VGUI_Surface031");
+    m_Readiness = new Readiness(std::make_unique<LoaderModuleSource>());
 
+    // Scan the DLLs on disk while the engine is still loading them, once they're loaded the
+    // offsets only have to be checked
     m_Offsets = new Offsets();
-
-    m_ClientMode = **(IClientMode***)(m_Offsets->g_pClientMode.address);
-
-    m_VR = new VR(this);
-    m_Hooks = new Hooks(this);
+    m_Offsets->PreResolve(OffsetTable::All);
+
+    // Each step waits only for what it needs, OpenVR starts while the game is still loading
+    TaskGraph init;
+    init.SetObserver([this](const std::string &event) { m_Readiness->Mark(event); });
+    int modules = init.Add("Modules", {}, [this]
+    {
+        for (const char *module : { "client.dll", "engine.dll", "materialsystem.dll", "server.dll", "vgui2.dll" })
+            m_Readiness->Wait(module);
+
+        m_BaseClient = (uintptr_t)GetModuleHandle("client.dll");
+        m_BaseEngine = (uintptr_t)GetModuleHandle("engine.dll");
+        m_BaseMaterialSystem = (uintptr_t)GetModuleHandle("materialsystem.dll");
+        m_BaseServer = (uintptr_t)GetModuleHandle("server.dll");
+        m_BaseVgui2 = (uintptr_t)GetModuleHandle("vgui2.dll");
+    });
+
+    int interfaces = init.Add("Interfaces", { modules }, [this]
+    {
+        m_ClientEntityList = (IClientEntityList *)GetInterface("client.dll", "VClientEntityList003");
+        m_EngineTrace = (IEngineTrace *)GetInterface("engine.dll", "EngineTraceClient004");
+        m_EngineClient = (IEngineClient *)GetInterface("engine.dll", "VEngineClient015");
+        m_MaterialSystem = (IMaterialSystem *)GetInterface("MaterialSystem.dll", "VMaterialSystem080");
+        m_ClientViewRender = (IViewRender *)GetInterface("client.dll", "VEngineRenderView013");
+        m_EngineViewRender = (IViewRender *)GetInterface("engine.dll", "VEngineRenderView013");
+        m_ModelInfo = (IModelInfo *)GetInterface("engine.dll", "VModelInfoClient004");
+        m_ModelRender = (IModelRender *)GetInterface("engine.dll", "VEngineModel016");
+        m_VguiInput = (IInput *)GetInterface("vgui2.dll", "VGUI_InputInternal001");
+        m_VguiSurface = (ISurface *)GetInterface("vguimatsurface.dll", "VGUI_Surface031");
+    });
+
+    int offsets = init.Add("Offsets", { modules }, [this]
+    {
+        // Anything not in Startup is only resolved when it's first used
+        m_Offsets->WarmUp(OffsetTable::Startup);
+        int clientMode = m_Offsets->g_pClientMode.Address();
+        if (!clientMode)
+            throw std::runtime_error("g_pClientMode wasn't found");
+        m_ClientMode = *(IClientMode**)clientMode;
+    });
+
+    int openVR = init.Add("OpenVR", {}, [this]
+    {
+        m_VR = new VR(this);
+    });
+
+    int rendering = init.Add("VR rendering", { openVR, interfaces }, [this]
+    {
+        m_VR->InitRendering();
+    });
+
+    init.Add("Hooks", { offsets, rendering }, [this]
+    {
+        m_Hooks = new Hooks(this);
+    });
+
+    // Tasks block on the game, so every task that can run at once gets its own thread
+    ThreadPool pool(4);
+    bool initialized = init.Run(pool);
+    m_Readiness->PrintTimeline();
+
+    // The hooks stay off if anything is missing
+    if (!initialized)
+    {
+        std::string errors = "Initialization failed:";
+        for (const std::string &error : init.Errors())
+            errors += "\n" + error;
+        errorMsg(errors.c_str());
+        return;
+    }
 
     m_Initialized = true;
 }
@@ -22,6 +22,7 @@ struct model_t;
 
 class Game;
 class Offsets;
+class Readiness;
 class VR;
 class Hooks;
 
@@ -67,6 +68,7 @@ public:
 
     Vector m_singlePlayerPortalColors[3] = { Vector(255.0f, 255.0f, 255.0f), Vector(64.0f, 160.0f, 255.0f), Vector(255.0f, 160.0f, 32.0f) };
 
+    Readiness *m_Readiness = nullptr;
     Offsets *m_Offsets = nullptr;
     VR *m_VR = nullptr;
     Hooks *m_Hooks = nullptr;
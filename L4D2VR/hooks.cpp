@@ -5,7 +5,9 @@
 #include "sdk_server.h"
 #include "vr.h"
 #include "offsets.h"
+#include "frametrace.h"
 #include <iostream>
+#include <iterator>
 
 Hooks::Hooks(Game *game)
 {
@@ -22,45 +24,22 @@ Hooks::Hooks(Game *game)
 
 	initSourceHooks();
 
-	//hkGetRenderTarget.enableHook();
-	hkCalcViewModelView.enableHook();
-
-	hkProcessUsercmds.enableHook();
-	hkReadUsercmd.enableHook();
-
-	//hkWriteUsercmdDeltaToBuffer.enableHook();
-	hkWriteUsercmd.enableHook();
-
-	hkCreateMove.enableHook();
-	hkEyePosition.enableHook();
-	hkRenderView.enableHook();
-
-
-	hkWeapon_ShootPosition.enableHook();
-	hkTraceFirePortal.enableHook();
-	hkCWeaponPortalgun_FirePortal.enableHook();
-
-	hkDrawSelf.enableHook();
-	hkPlayerPortalled.enableHook();
-
-	//hkComputeError.enableHook();
-	hkUpdateObject.enableHook();
-	hkUpdateObjectVM.enableHook();
-	//hkRotateObject.enableHook();
-	hkEyeAngles.enableHook();
-
-	hkGetDefaultFOV.enableHook();
-	hkGetFOV.enableHook();
-	hkGetViewModelFOV.enableHook();
+	// Everything is created first, then enabled with a single thread suspension
+	HookBatch batch;
+	for (const HookEntry &entry : HookTable)
+	{
+		if (entry.enabledByDefault && createFromTable(entry))
+			batch.enable(*entry.hook);
+	}
+	batch.apply();
 
-	hkSetDrawOnlyForSplitScreenUser.enableHook();
-	//kClientThink.enableHook();
-	hkPrecache.enableHook();
-	hkCHudCrosshair_ShouldDraw.enableHook();
+	printHookStatus();
 }
 
 Hooks::~Hooks()
 {
+	HOOK_STATS_PRINT_SESSION();
+
 	if (MH_Uninitialize() != MH_OK)
 	{
 		Game::errorMsg("Failed to uninitialize MinHook");
@@ -68,115 +47,131 @@ Hooks::~Hooks()
 }
 
 
-int Hooks::initSourceHooks()
+int HookBatch::apply()
 {
-	/*LPVOID pGetRenderTargetVFunc = (LPVOID)(m_Game->m_Offsets->GetRenderTarget.address);
-	hkGetRenderTarget.createHook(pGetRenderTargetVFunc, &dGetRenderTarget);*/
-
-	LPVOID pRenderViewVFunc = (LPVOID)(m_Game->m_Offsets->RenderView.address);
-	hkRenderView.createHook(pRenderViewVFunc, &dRenderView);
-
-	LPVOID calcViewModelViewAddr = (LPVOID)(m_Game->m_Offsets->CalcViewModelView.address);
-	hkCalcViewModelView.createHook(calcViewModelViewAddr, &dCalcViewModelView);
-
-	LPVOID ProcessUsercmdsAddr = (LPVOID)(m_Game->m_Offsets->ProcessUsercmds.address);
-	hkProcessUsercmds.createHook(ProcessUsercmdsAddr, &dProcessUsercmds);
-
-	LPVOID ReadUserCmdAddr = (LPVOID)(m_Game->m_Offsets->ReadUserCmd.address);
-	hkReadUsercmd.createHook(ReadUserCmdAddr, &dReadUsercmd);
-
-	/*LPVOID WriteUsercmdDeltaToBufferAddr = (LPVOID)(m_Game->m_Offsets->WriteUsercmdDeltaToBuffer.address);
-	hkWriteUsercmdDeltaToBuffer.createHook(WriteUsercmdDeltaToBufferAddr, &dWriteUsercmdDeltaToBuffer);*/
+	std::vector<Change> queued;
+	for (const Change &change : m_Changes)
+	{
+		if (!change.hook->pTarget || change.hook->isEnabled == change.enable)
+			continue;
 
-	LPVOID WriteUsercmdAddr = (LPVOID)(m_Game->m_Offsets->WriteUsercmd.address);
-	hkWriteUsercmd.createHook(WriteUsercmdAddr, &dWriteUsercmd);
+		MH_STATUS status = change.enable ? MH_QueueEnableHook(change.hook->pTarget) : MH_QueueDisableHook(change.hook->pTarget);
+		if (status != MH_OK)
+		{
+			char errorString[256];
+			sprintf_s(errorString, 256, "Failed to queue hook: %s", MH_StatusToString(status));
+			Game::errorMsg(errorString);
+			continue;
+		}
+		queued.push_back(change);
+	}
+	m_Changes.clear();
 
-	/*LPVOID AdjustEngineViewportAddr = (LPVOID)(m_Game->m_Offsets->AdjustEngineViewport.address);
-	hkAdjustEngineViewport.createHook(AdjustEngineViewportAddr, &dAdjustEngineViewport);
+	if (queued.empty())
+		return 0;
 
-	LPVOID ViewportAddr = (LPVOID)(m_Game->m_Offsets->Viewport.address);
-	hkViewport.createHook(ViewportAddr, &dViewport);
+	MH_STATUS status = MH_ApplyQueued();
+	if (status != MH_OK)
+	{
+		char errorString[256];
+		sprintf_s(errorString, 256, "Failed to apply queued hooks: %s", MH_StatusToString(status));
+		Game::errorMsg(errorString);
+		return 1;
+	}
 
-	LPVOID GetViewportAddr = (LPVOID)(m_Game->m_Offsets->GetViewport.address);
-	hkGetViewport.createHook(GetViewportAddr, &dGetViewport);*/
+	for (const Change &change : queued)
+		change.hook->isEnabled = change.enable;
+	return 0;
+}
 
-	LPVOID EyePositionAddr = (LPVOID)(m_Game->m_Offsets->EyePosition.address);
-	hkEyePosition.createHook(EyePositionAddr, &dEyePosition);
 
-	/*LPVOID DrawModelExecuteAddr = (LPVOID)(m_Game->m_Offsets->DrawModelExecute.address);
-	hkDrawModelExecute.createHook(DrawModelExecuteAddr, &dDrawModelExecute);*/
+static constexpr bool HookOffsetsInTable()
+{
+	for (const HookEntry &entry : Hooks::HookTable)
+	{
+		if (Offsets::IndexOf(*entry.offset) == Offsets::Count)
+			return false;
+	}
+	return true;
+}
 
-	LPVOID PushRenderTargetAddr = (LPVOID)(m_Game->m_Offsets->PushRenderTargetAndViewport.address);
-	hkPushRenderTargetAndViewport.createHook(PushRenderTargetAddr, &dPushRenderTargetAndViewport);
+bool Hooks::createFromTable(const HookEntry &entry)
+{
+	static_assert(HookOffsetsInTable(), "Hook offset is missing from OffsetTable::All");
 
-	LPVOID PopRenderTargetAddr = (LPVOID)(m_Game->m_Offsets->PopRenderTargetAndViewport.address);
-	hkPopRenderTargetAndViewport.createHook(PopRenderTargetAddr, &dPopRenderTargetAndViewport);
+	if (entry.hook->pTarget)
+		return true;
+	if (entry.hook->createFailed)
+		return false;
 
-	LPVOID VGui_PaintAddr = (LPVOID)(m_Game->m_Offsets->VGui_Paint.address);
-	hkVgui_Paint.createHook(VGui_PaintAddr, &dVGui_Paint);
+	// Offsets reports it when the signature isn't found
+	LPVOID target = (LPVOID)m_Game->m_Offsets->Get(*entry.offset).Address();
+	if (!target || entry.create(target) != 0)
+	{
+		entry.hook->createFailed = true;
+		return false;
+	}
+	return true;
+}
 
-	/*LPVOID IsSplitScreenAddr = (LPVOID)(m_Game->m_Offsets->IsSplitScreen.address);
-	hkIsSplitScreen.createHook(IsSplitScreenAddr, &dIsSplitScreen);*/
+int Hooks::setGroupEnabled(HookGroup group, bool enabled)
+{
+	HookBatch batch;
+	for (const HookEntry &entry : HookTable)
+	{
+		if (entry.group != group)
+			continue;
 
-	LPVOID PrePushRenderTargetAddr = (LPVOID)(m_Game->m_Offsets->PrePushRenderTarget.address);
-	hkPrePushRenderTarget.createHook(PrePushRenderTargetAddr, &dPrePushRenderTarget);
+		if (!enabled)
+			batch.disable(*entry.hook);
+		else if (createFromTable(entry))
+			batch.enable(*entry.hook);
+	}
+	return batch.apply();
+}
 
-	/*LPVOID GetFullScreenTextureAddr = (LPVOID)(m_Game->m_Offsets->GetFullScreenTexture.address);
-	hkGetFullScreenTexture.createHook(GetFullScreenTextureAddr, &dGetFullScreenTexture);*/
+void Hooks::printHookStatus()
+{
+	static constexpr const char *GroupNames[] = {
+		"Rendering", "Input", "Aiming", "Portalling", "Crosshair", "Hud", "Grabbables", "PortalGunVFX", "LaserPointer"
+	};
+	static_assert(std::size(GroupNames) == (size_t)HookGroup::Count, "GroupNames is missing a HookGroup");
 
-	LPVOID Weapon_ShootPositionAddr = (LPVOID)(m_Game->m_Offsets->Weapon_ShootPosition.address);
-	hkWeapon_ShootPosition.createHook(Weapon_ShootPositionAddr, &dWeapon_ShootPosition);
-	
-	LPVOID TraceFirePortalAddr = (LPVOID)(m_Game->m_Offsets->TraceFirePortalServer.address);
-	hkTraceFirePortal.createHook(TraceFirePortalAddr, &dTraceFirePortal);
+	std::cout << "Hooks:\n";
+	for (const HookEntry &entry : HookTable)
+	{
+		const char *status = "not created";
+		if (entry.hook->createFailed)
+			status = "failed";
+		else if (entry.hook->isEnabled)
+			status = "enabled";
+		else if (entry.hook->pTarget)
+			status = "disabled";
+
+		std::cout << "  " << entry.name << " (" << GroupNames[(int)entry.group] << "): " << status << "\n";
+	}
+}
 
-	hkCWeaponPortalgun_FirePortal.createHook((LPVOID)m_Game->m_Offsets->CWeaponPortalgun_FirePortal.address, &dCWeaponPortalgun_FirePortal);
+int Hooks::initSourceHooks()
+{
+	UTIL_Portal_FirstAlongRay = (tUTIL_Portal_FirstAlongRay)m_Game->m_Offsets->UTIL_Portal_FirstAlongRay.Address();
+	UTIL_IntersectRayWithPortal = (tUTIL_IntersectRayWithPortal)m_Game->m_Offsets->UTIL_IntersectRayWithPortal.Address();
+	UTIL_Portal_AngleTransform = (tUTIL_Portal_AngleTransform)m_Game->m_Offsets->UTIL_Portal_AngleTransform.Address();
 
-	LPVOID DrawSelfAddr = (LPVOID)(m_Game->m_Offsets->DrawSelf.address);
-	hkDrawSelf.createHook(DrawSelfAddr, &dDrawSelf);
-	
-	LPVOID ClipTransformAddr = (LPVOID)(m_Game->m_Offsets->ClipTransform.address);
-	hkClipTransform.createHook(ClipTransformAddr, &dClipTransform);
-
-	// Portalling
-	LPVOID PlayerPortalledAddr = (LPVOID)(m_Game->m_Offsets->PlayerPortalled.address);
-	hkPlayerPortalled.createHook(PlayerPortalledAddr, &dPlayerPortalled);
-
-	UTIL_Portal_FirstAlongRay = (tUTIL_Portal_FirstAlongRay)m_Game->m_Offsets->UTIL_Portal_FirstAlongRay.address;
-	UTIL_IntersectRayWithPortal = (tUTIL_IntersectRayWithPortal)m_Game->m_Offsets->UTIL_IntersectRayWithPortal.address;
-	UTIL_Portal_AngleTransform = (tUTIL_Portal_AngleTransform)m_Game->m_Offsets->UTIL_Portal_AngleTransform.address;
-
-	LPVOID CreateMoveAddr = (LPVOID)(m_Game->m_Offsets->CreateMove.address);
-	hkCreateMove.createHook(CreateMoveAddr, &dCreateMove);
-
-	// Grababbles
-	hkComputeError.createHook((LPVOID)(m_Game->m_Offsets->ComputeError.address), &dComputeError);
-	hkUpdateObject.createHook((LPVOID)(m_Game->m_Offsets->UpdateObject.address), &dUpdateObject);
-	hkUpdateObjectVM.createHook((LPVOID)(m_Game->m_Offsets->UpdateObjectVM.address), &dUpdateObjectVM);
-	hkRotateObject.createHook((LPVOID)(m_Game->m_Offsets->RotateObject.address), &dRotateObject);
-	hkEyeAngles.createHook((LPVOID)(m_Game->m_Offsets->EyeAngles.address), &dEyeAngles);
-
-	// Portal Gun VFX
-	hkGetDefaultFOV.createHook((LPVOID)(m_Game->m_Offsets->GetDefaultFOV.address), &dGetDefaultFOV);
-	hkGetFOV.createHook((LPVOID)(m_Game->m_Offsets->GetFOV.address), &dGetFOV);
-	hkGetViewModelFOV.createHook((LPVOID)(m_Game->m_Offsets->GetViewModelFOV.address), &dGetViewModelFOV);
-	
 	// Laser Pointer
-	GetPortalPlayer = (tGetPortalPlayer)m_Game->m_Offsets->GetPortalPlayer.address;
-	CreatePingPointer = (tCreatePingPointer)m_Game->m_Offsets->CreatePingPointer.address;
-	PrecacheParticleSystem = (tPrecacheParticleSystem)m_Game->m_Offsets->PrecacheParticleSystem.address;
-	hkPrecache.createHook((LPVOID)(m_Game->m_Offsets->Precache.address), &dPrecache);
-	hkSetDrawOnlyForSplitScreenUser.createHook((LPVOID)m_Game->m_Offsets->SetDrawOnlyForSplitScreenUser.address, &dSetDrawOnlyForSplitScreenUser);
-	hkCHudCrosshair_ShouldDraw.createHook((LPVOID)m_Game->m_Offsets->CHudCrosshair_ShouldDraw.address, &dCHudCrosshair_ShouldDraw);
-
-	//
-	EntityIndex = (tEntindex)m_Game->m_Offsets->CBaseEntity_entindex.address;
-	GetOwner = (tGetOwner)m_Game->m_Offsets->GetOwner.address;
-	GetFullScreenTexture = (tGetFullScreenTexture)m_Game->m_Offsets->GetFullScreenTexture.address;
+	GetPortalPlayer = (tGetPortalPlayer)m_Game->m_Offsets->GetPortalPlayer.Address();
+	CreatePingPointer = (tCreatePingPointer)m_Game->m_Offsets->CreatePingPointer.Address();
+	PrecacheParticleSystem = (tPrecacheParticleSystem)m_Game->m_Offsets->PrecacheParticleSystem.Address();
+
+	EntityIndex = (tEntindex)m_Game->m_Offsets->CBaseEntity_entindex.Address();
+	// Resolved here rather than in dTraceFirePortal, which runs on the game thread
+	GetOwner = (tGetOwner)m_Game->m_Offsets->GetOwner.Address();
 	return 1;
 } 
 
 bool __fastcall Hooks::dCHudCrosshair_ShouldDraw(void* ecx, void* edx) {
+	HOOK_STATS_DETOUR();
+
 	bool shouldDraw = hkCHudCrosshair_ShouldDraw.fOriginal(ecx);
 
 	m_VR->m_DrawCrosshair = shouldDraw;
@@ -185,32 +180,46 @@ bool __fastcall Hooks::dCHudCrosshair_ShouldDraw(void* ecx, void* edx) {
 }
 
 void __fastcall Hooks::dPrecache(void* ecx, void* edx) {
+	HOOK_STATS_DETOUR();
+
 	hkPrecache.fOriginal(ecx);
 	PrecacheParticleSystem("robot_point_beam");
 }
 
 void __fastcall Hooks::dClientThink(void* ecx, void* edx) {
+	HOOK_STATS_DETOUR();
+
 	hkClientThink.fOriginal(ecx);
 }
 
 void __fastcall Hooks::dSetDrawOnlyForSplitScreenUser(void* ecx, void* edx, int nSlot) {
+	HOOK_STATS_DETOUR();
+
 	hkSetDrawOnlyForSplitScreenUser.fOriginal(ecx, -1);
 }
 
 ITexture *__fastcall Hooks::dGetFullScreenTexture()
 {
+	HOOK_STATS_DETOUR();
+
 	ITexture *result = hkGetFullScreenTexture.fOriginal();
 	return result;
 }
 
 ITexture* __fastcall Hooks::dGetRenderTarget(void* ecx, void* edx)
 {
+	HOOK_STATS_DETOUR();
+
 	ITexture* result = hkGetRenderTarget.fOriginal(ecx);
 	return result;
 }
 
 void __fastcall Hooks::dRenderView(void *ecx, void *edx, CViewSetup &setup, CViewSetup &hudViewSetup, int nClearFlags, int whatToDraw)
 {
+	// A frame runs from one RenderView to the next
+	HOOK_STATS_END_FRAME();
+	HOOK_STATS_DETOUR();
+
 	if (!m_VR->m_CreatedVRTextures) {
 		m_VR->CreateVRTextures();
 	}
@@ -218,7 +227,10 @@ void __fastcall Hooks::dRenderView(void *ecx, void *edx, CViewSetup &setup, CVie
 	if (m_Game->m_VguiSurface->IsCursorVisible())
 		return hkRenderView.fOriginal(ecx, setup, hudViewSetup, nClearFlags, whatToDraw);
 
-	//VPanel* g_pFullscreenRootPanel = *(VPanel**)(m_Game->m_Offsets->g_pFullscreenRootPanel.address);
+	// The frame is simulated, it's rendered with the newest poses
+	m_VR->BeginFrame();
+
+	//VPanel* g_pFullscreenRootPanel = *(VPanel**)(m_Game->m_Offsets->g_pFullscreenRootPanel.Address());
 
 	IMaterialSystem* matSystem = m_Game->m_MaterialSystem;
 
@@ -255,6 +267,7 @@ void __fastcall Hooks::dRenderView(void *ecx, void *edx, CViewSetup &setup, CVie
 	}
 
 	m_VR->m_SetupOrigin = position;
+	m_VR->UpdateTransforms();
 
 	Vector hmdAngle = m_VR->GetViewAngle();
 	QAngle inGameAngle(hmdAngle.x, hmdAngle.y, hmdAngle.z);
@@ -281,27 +294,35 @@ void __fastcall Hooks::dRenderView(void *ecx, void *edx, CViewSetup &setup, CVie
 	int playerIndex = m_Game->m_EngineClient->GetLocalPlayer();
 	C_BasePlayer* localPlayer = (C_BasePlayer*)m_Game->GetClientEntity(playerIndex);
 
-	// Left eye CViewSetup
-	QAngle tempAngle = QAngle(setup.angles.x, setup.angles.y, setup.angles.z);
-	leftEyeView.origin = m_VR->TraceEye((uint32_t*)localPlayer, position, m_VR->GetViewOriginLeft(position), tempAngle);
-	leftEyeView.angles.y = tempAngle.y;
+	// Left eye CViewSetup, with the HMD pose predicted for when this frame is shown
+	EyeViewData eyeView = m_VR->LateLatchHmdPose(vr::Eye_Left);
+	leftEyeView.angles = Vector(eyeView.Angles.x, eyeView.Angles.y, eyeView.Angles.z);
+	leftEyeView.origin = m_VR->TraceEye((uint32_t*)localPlayer, position, eyeView.Origin, eyeView.EyeRotation);
+	leftEyeView.angles.y = eyeView.EyeRotation.ToAngles().y;
 
 	//std::cout << "dRenderView - Left Start\n";
 	IMatRenderContext* rndrContext = matSystem->GetRenderContext();
 	rndrContext->SetRenderTarget(m_VR->m_LeftEyeTexture);
 	rndrContext->Release();
-	hkRenderView.fOriginal(ecx, leftEyeView, hudViewSetup, nClearFlags, whatToDraw);
+	{
+		FRAME_TRACE_SCOPE("RenderView left eye");
+		hkRenderView.fOriginal(ecx, leftEyeView, hudViewSetup, nClearFlags, whatToDraw);
+	}
 	
 	// Right eye CViewSetup
-	tempAngle = QAngle(setup.angles.x, setup.angles.y, setup.angles.z);
-	rightEyeView.origin = m_VR->TraceEye((uint32_t*)localPlayer, position, m_VR->GetViewOriginRight(position), tempAngle);
-	rightEyeView.angles.y = tempAngle.y;
+	eyeView = m_VR->LateLatchHmdPose(vr::Eye_Right);
+	rightEyeView.angles = Vector(eyeView.Angles.x, eyeView.Angles.y, eyeView.Angles.z);
+	rightEyeView.origin = m_VR->TraceEye((uint32_t*)localPlayer, position, eyeView.Origin, eyeView.EyeRotation);
+	rightEyeView.angles.y = eyeView.EyeRotation.ToAngles().y;
 
 	//std::cout << "dRenderView - Right Start\n";
 	rndrContext = matSystem->GetRenderContext();
 	rndrContext->SetRenderTarget(m_VR->m_RightEyeTexture);
 	rndrContext->Release();
-	hkRenderView.fOriginal(ecx, rightEyeView, hudViewSetup, nClearFlags, whatToDraw);
+	{
+		FRAME_TRACE_SCOPE("RenderView right eye");
+		hkRenderView.fOriginal(ecx, rightEyeView, hudViewSetup, nClearFlags, whatToDraw);
+	}
 
 	m_PushedHud = false;
 
@@ -340,12 +361,19 @@ void __fastcall Hooks::dRenderView(void *ecx, void *edx, CViewSetup &setup, CVie
 
 bool __fastcall Hooks::dCreateMove(void *ecx, void *edx, float flInputSampleTime, CUserCmd *cmd)
 {
+	HOOK_STATS_DETOUR();
+	FRAME_TRACE_SCOPE("Hooks::dCreateMove");
+
 	if (!cmd->command_number)
 		return hkCreateMove.fOriginal(ecx, flInputSampleTime, cmd);
 
 	if (m_VR->m_IsVREnabled)
 	{
-		cmd->viewangles = m_VR->m_HmdAngAbs;
+		// Aim with where the HMD and hand are now, not where they were when the frame started
+		if (m_VR->ResampleInputPose())
+			cmd->viewangles = m_VR->m_InputPose.HmdAngAbs;
+		else
+			cmd->viewangles = m_VR->m_HmdAngAbs;
 
 		vr::InputAnalogActionData_t analogActionData;
 		if (m_VR->GetAnalogActionData(m_VR->m_ActionWalk, analogActionData)) {
@@ -410,11 +438,15 @@ bool __fastcall Hooks::dCreateMove(void *ecx, void *edx, float flInputSampleTime
 
 void __fastcall Hooks::dEndFrame(void *ecx, void *edx)
 {
+	HOOK_STATS_DETOUR();
+
 	return hkEndFrame.fOriginal(ecx);
 }
 
 void __fastcall Hooks::dCalcViewModelView(void *ecx, void *edx, const Vector &eyePosition, const QAngle &eyeAngles)
 {
+	HOOK_STATS_DETOUR();
+
 	Vector vecNewOrigin = eyePosition;
 	QAngle vecNewAngles = eyeAngles;
 
@@ -432,6 +464,8 @@ void __fastcall Hooks::dCalcViewModelView(void *ecx, void *edx, const Vector &ey
 
 float __fastcall Hooks::dProcessUsercmds(void *ecx, void *edx, edict_t *player, void *buf, int numcmds, int totalcmds, int dropped_packets, bool ignore, bool paused)
 {
+	HOOK_STATS_DETOUR();
+
 	Server_BaseEntity *pPlayer = (Server_BaseEntity*)player->m_pUnk->GetBaseEntity();
 
 	int index = EntityIndex(pPlayer);
@@ -442,13 +476,15 @@ float __fastcall Hooks::dProcessUsercmds(void *ecx, void *edx, edict_t *player,
 
 int Hooks::dWriteUsercmd(bf_write *buf, CUserCmd *to, CUserCmd *from)
 {
+	HOOK_STATS_DETOUR();
+
 	auto result =  hkWriteUsercmd.fOriginal(buf, to, from);
 
 	// Let's write our stuff into the buffer
 	if (m_VR->m_IsVREnabled)
 	{
-		Vector controllerPos = m_VR->GetRightControllerAbsPos();
-		QAngle controllerAngles = m_VR->GetRightControllerAbsAngle();
+		Vector controllerPos = m_VR->GetInputRightControllerAbsPos();
+		QAngle controllerAngles = m_VR->GetInputRightControllerAbsAngle();
 
 		buf->WriteChar(-2);
 		buf->WriteBitVec3Coord(controllerPos);
@@ -460,6 +496,8 @@ int Hooks::dWriteUsercmd(bf_write *buf, CUserCmd *to, CUserCmd *from)
 
 int Hooks::dReadUsercmd(bf_read *buf, CUserCmd* move, CUserCmd* from)
 {
+	HOOK_STATS_DETOUR();
+
 	auto result = hkReadUsercmd.fOriginal(buf, move, from);
 
 	int i = m_Game->m_CurrentUsercmdID;
@@ -486,6 +524,8 @@ int Hooks::dReadUsercmd(bf_read *buf, CUserCmd* move, CUserCmd* from)
 
 void Hooks::dAdjustEngineViewport(int &x, int &y, int &width, int &height)
 {
+	HOOK_STATS_DETOUR();
+
 	width = m_VR->m_RenderWidth;
 	height = m_VR->m_RenderHeight;
 
@@ -494,6 +534,8 @@ void Hooks::dAdjustEngineViewport(int &x, int &y, int &width, int &height)
 
 void Hooks::dGetViewport(void *ecx, void *edx, int &x, int &y, int &width, int &height)
 {
+	HOOK_STATS_DETOUR();
+
 	hkGetViewport.fOriginal(ecx, x, y, width, height);
 
 	width = m_VR->m_RenderWidth;
@@ -502,11 +544,15 @@ void Hooks::dGetViewport(void *ecx, void *edx, int &x, int &y, int &width, int &
 
 int Hooks::dGetPrimaryAttackActivity(void *ecx, void *edx, void *meleeInfo)
 {
+	HOOK_STATS_DETOUR();
+
 	return hkGetPrimaryAttackActivity.fOriginal(ecx, meleeInfo);
 }
 
 Vector *Hooks::dEyePosition(void *ecx, void *edx, Vector *eyePos)
 {
+	HOOK_STATS_DETOUR();
+
 	Vector *result = hkEyePosition.fOriginal(ecx, eyePos);
 	return result;
 }
@@ -514,6 +560,8 @@ Vector *Hooks::dEyePosition(void *ecx, void *edx, Vector *eyePos)
 // We'll keep this for... future reference!
 void Hooks::dDrawModelExecute(void *ecx, void *edx, void *state, const ModelRenderInfo_t &info, void *pCustomBoneToWorld)
 {
+	HOOK_STATS_DETOUR();
+
 	if (info.pModel)
 	{
 		std::string modelName = m_Game->m_ModelInfo->GetModelName(info.pModel);
@@ -539,6 +587,8 @@ void Hooks::dDrawModelExecute(void *ecx, void *edx, void *state, const ModelRend
 
 void Hooks::dPushRenderTargetAndViewport(void *ecx, void *edx, ITexture *pTexture, ITexture *pDepthTexture, int nViewX, int nViewY, int nViewW, int nViewH)
 {
+	HOOK_STATS_DETOUR();
+
 	if (m_VR->m_CreatedVRTextures && !m_PushedHud)
 	{
 		pTexture = m_VR->m_HUDTexture;
@@ -568,6 +618,8 @@ void Hooks::dPushRenderTargetAndViewport(void *ecx, void *edx, ITexture *pTextur
 
 void Hooks::dPopRenderTargetAndViewport(void *ecx, void *edx)
 {
+	HOOK_STATS_DETOUR();
+
 	if (!m_VR->m_CreatedVRTextures)
 		return hkPopRenderTargetAndViewport.fOriginal(ecx);
 
@@ -588,6 +640,8 @@ void Hooks::dPopRenderTargetAndViewport(void *ecx, void *edx)
 
 void Hooks::dVGui_Paint(void *ecx, void *edx, int mode)
 {
+	HOOK_STATS_DETOUR();
+
 	if (!m_VR->m_CreatedVRTextures || m_VR->m_Game->m_VguiSurface->IsCursorVisible())
 		return hkVgui_Paint.fOriginal(ecx, mode);
 
@@ -601,6 +655,8 @@ void Hooks::dVGui_Paint(void *ecx, void *edx, int mode)
 
 int Hooks::dIsSplitScreen()
 {
+	HOOK_STATS_DETOUR();
+
 	//std::cout << "dIsSplitScreen: " << m_PushHUDStep << "\n";
 
 	if (m_PushHUDStep == 0)
@@ -613,6 +669,8 @@ int Hooks::dIsSplitScreen()
 
 DWORD *Hooks::dPrePushRenderTarget(void *ecx, void *edx, int a2)
 {
+	HOOK_STATS_DETOUR();
+
 	//std::cout << "dPrePushRenderTarget: " << m_PushHUDStep << "\n";
 
 	if (m_PushHUDStep == 1)
@@ -625,6 +683,8 @@ DWORD *Hooks::dPrePushRenderTarget(void *ecx, void *edx, int a2)
 
 Vector* Hooks::dWeapon_ShootPosition(void* ecx, void* edx, Vector* eyePos)
 {
+	HOOK_STATS_DETOUR();
+
 	Vector* result = hkWeapon_ShootPosition.fOriginal(ecx, eyePos);
 
 	int localIndex = m_Game->m_EngineClient->GetLocalPlayer();
@@ -644,6 +704,8 @@ Vector* Hooks::dWeapon_ShootPosition(void* ecx, void* edx, Vector* eyePos)
 }
 
 void* Hooks::dCWeaponPortalgun_FirePortal(void* ecx, void* edx, bool bPortal2, Vector* pVector) {
+	HOOK_STATS_DETOUR();
+
 	bool wasTrue = m_VR->m_OverrideEyeAngles;
 
 	m_VR->m_OverrideEyeAngles = true;
@@ -658,13 +720,15 @@ void* Hooks::dCWeaponPortalgun_FirePortal(void* ecx, void* edx, bool bPortal2, V
 
 bool __fastcall Hooks::dTraceFirePortal(void* ecx, void* edx, const Vector& vTraceStart, const Vector& vDirection, bool bPortal2, int iPlacedBy, void* tr) //trace_tx& tr, Vector& vFinalPosition //  , Vector& vFinalPosition, QAngle& qFinalAngles, int iPlacedBy, bool bTest /*= false*/
 {
+	HOOK_STATS_DETOUR();
+
 	Vector vNewTraceStart = vTraceStart;
 	Vector vNewDirection = vDirection;
 
 	if (iPlacedBy == 2) {
 		int localIndex = m_Game->m_EngineClient->GetLocalPlayer();
 
-		auto owner = GetOwner(ecx);
+		auto owner = GetOwner ? GetOwner(ecx) : nullptr;
 
 		if (owner) {
 			int index = EntityIndex(owner);
@@ -690,6 +754,8 @@ bool __fastcall Hooks::dTraceFirePortal(void* ecx, void* edx, const Vector& vTra
 
 void __fastcall Hooks::dPlayerPortalled(void* ecx, void* edx, void* a2, __int64 a3)
 {
+	HOOK_STATS_DETOUR();
+
 	CBaseEntity* pBaseEntity = (CBaseEntity*)ecx;
 
 	QAngle angAbsRotationBefore;
@@ -709,12 +775,16 @@ void __fastcall Hooks::dPlayerPortalled(void* ecx, void* edx, void* a2, __int64
 }
 
 int Hooks::dGetModeHeight(void* ecx, void* edx) {
+	HOOK_STATS_DETOUR();
+
 	//std::cout << "dGetModeHeight\n";
 	return m_VR->m_RenderHeight;
 }
 
 bool Hooks::dClipTransform(const Vector& point, Vector* pScreen)
 {
+	HOOK_STATS_DETOUR();
+
 	return hkClipTransform.fOriginal(point, pScreen);
 }
 
@@ -729,6 +799,8 @@ bool Hooks::ScreenTransform(const Vector& point, Vector* pScreen, int width, int
 }
 
 int __fastcall Hooks::dDrawSelf(void* ecx, void* edx, int x, int y, int w, int h, const void* clr, float flApparentZ) {
+	HOOK_STATS_DETOUR();
+
 	//std::cout << "dDrawSelf - X: " << x << ", Y: " << y << ", W: " << w << ", H: " << h << ", Z: " << flApparentZ << "\n";
 
 	//int playerIndex = m_Game->m_EngineClient->GetLocalPlayer();
@@ -762,6 +834,8 @@ int __fastcall Hooks::dDrawSelf(void* ecx, void* edx, int x, int y, int w, int h
 }
 
 void __cdecl Hooks::dVGui_GetHudBounds(int slot, int& x, int& y, int& w, int& h) {
+	HOOK_STATS_DETOUR();
+
 	if (m_VR->m_IsVREnabled && !m_Game->m_VguiSurface->IsCursorVisible())
 	{
 		x = y = 0;
@@ -775,6 +849,8 @@ void __cdecl Hooks::dVGui_GetHudBounds(int slot, int& x, int& y, int& w, int& h)
 }
 
 void __cdecl Hooks::dVGui_GetPanelBounds(int slot, int& x, int& y, int& w, int& h) {
+	HOOK_STATS_DETOUR();
+
 	if (m_VR->m_IsVREnabled && !m_Game->m_VguiSurface->IsCursorVisible())
 	{
 		x = y = 0;
@@ -789,56 +865,76 @@ void __cdecl Hooks::dVGui_GetPanelBounds(int slot, int& x, int& y, int& w, int&
 }
 
 void __cdecl Hooks::dVGUI_UpdateScreenSpaceBounds(int nNumSplits, int sx, int sy, int sw, int sh) {
+	HOOK_STATS_DETOUR();
+
 	hkVGUI_UpdateScreenSpaceBounds.fOriginal(nNumSplits, sx, sy, m_VR->m_RenderWidth, m_VR->m_RenderHeight);
 }
 
 void __cdecl Hooks::dVGui_GetTrueScreenSize(int &w, int &h) {
+	HOOK_STATS_DETOUR();
+
 	w = m_VR->m_RenderWidth;
 	h = m_VR->m_RenderHeight;
 }
 
 void __fastcall Hooks::dGetScreenSize(void* ecx, void* edx, int& wide, int& tall) {
+	HOOK_STATS_DETOUR();
+
 	//hkGetScreenSize.fOriginal(ecx, wide, tall);
 	wide = m_VR->m_RenderWidth;
 	tall = m_VR->m_RenderHeight;
 }
 
 void __cdecl Hooks::dGetHudSize(int& w, int& h) {
+	HOOK_STATS_DETOUR();
+
 	w = m_VR->m_RenderWidth;
 	h = m_VR->m_RenderHeight;
 }
 
 void __fastcall Hooks::dPush2DView(void* ecx, void* edx, IMatRenderContext* pRenderContext, const CViewSetup& view, int nFlags, ITexture* pRenderTarget, void* frustumPlanes) {
+	HOOK_STATS_DETOUR();
+
 	m_PushedHud = false;
 
 	return hkPush2DView.fOriginal(ecx, pRenderContext, view, nFlags, pRenderTarget, frustumPlanes);
 }
 
 void __fastcall Hooks::dRender(void* ecx, void* edx, vrect_t* rect) {
+	HOOK_STATS_DETOUR();
+
 	//std::cout << "dRender - X: " << rect->x << ", Y: " << rect->y << ", W: " << rect->width << ", H: " << rect->height  << "\n";
 
 	return hkRender.fOriginal(ecx, rect);
 }
 
 void __fastcall Hooks::dSetBounds(void* ecx, void* edx, int x, int y, int w, int h) {
+	HOOK_STATS_DETOUR();
+
 	std::cout << "dSetBounds - X: " << x << ", Y: " << y << ", W: " << w << ", H: " << h << "\n";
 
 	hkSetBounds.fOriginal(ecx, x, y, m_VR->m_RenderWidth, m_VR->m_RenderHeight);
 }
 
 void __fastcall Hooks::dSetSize(void* ecx, void* edx, int wide, int tall) {
+	HOOK_STATS_DETOUR();
+
 	hkSetSize.fOriginal(ecx, wide, tall);
 
 	//std::cout << "dSetSize - Wide: " << wide << ", Tall: " << tall  << "\n";
 }
 
 void __fastcall Hooks::dGetClipRect(void* ecx, void* edx, int& x0, int& y0, int& x1, int& y1) {
+	HOOK_STATS_DETOUR();
+
 	hkGetClipRect.fOriginal(ecx, x0, y0, x1, y1);
 
 	//std::cout << "dGetClipRect - X: " << x0 << ", Y: " << y0 << ", W: " << x1 << ", H: " << y1  << "\n";
 }
 
 double __fastcall Hooks::dComputeError(void* ecx, void* edx) {
+	HOOK_STATS_DETOUR();
+
 	bool wasTrue = m_VR->m_OverrideEyeAngles;
 
 	m_VR->m_OverrideEyeAngles = true;
@@ -852,6 +948,8 @@ double __fastcall Hooks::dComputeError(void* ecx, void* edx) {
 }
 
 bool __fastcall Hooks::dUpdateObject(void* ecx, void* edx, void* pPlayer, float flError, bool bIsTeleport) {
+	HOOK_STATS_DETOUR();
+
 	bool wasTrue = m_VR->m_OverrideEyeAngles;
 
 	m_VR->m_OverrideEyeAngles = true;
@@ -865,6 +963,8 @@ bool __fastcall Hooks::dUpdateObject(void* ecx, void* edx, void* pPlayer, float
 }
 
 bool __fastcall Hooks::dUpdateObjectVM(void* ecx, void* edx, void* pPlayer, float flError) {
+	HOOK_STATS_DETOUR();
+
 	bool wasTrue = m_VR->m_OverrideEyeAngles;
 
 	m_VR->m_OverrideEyeAngles = true;
@@ -879,6 +979,8 @@ bool __fastcall Hooks::dUpdateObjectVM(void* ecx, void* edx, void* pPlayer, floa
 
 // This function is apparently not used by Portal 2, remove?
 void __fastcall Hooks::dRotateObject(void* ecx, void* edx, void* pPlayer, float fRotAboutUp, float fRotAboutRight, bool bUseWorldUpInsteadOfPlayerUp) {
+	HOOK_STATS_DETOUR();
+
 	bool wasTrue = m_VR->m_OverrideEyeAngles;
 
 	m_VR->m_OverrideEyeAngles = true;
@@ -892,6 +994,8 @@ void __fastcall Hooks::dRotateObject(void* ecx, void* edx, void* pPlayer, float
 // This is CPlayerBase, do we also need to hook CPortalPlayer? can the same function be used by both?
 // This works for release, but why was it crashing before??? TODO: buy a c++ book...
 QAngle& __fastcall Hooks::dEyeAngles(void* ecx, void* edx) {
+	HOOK_STATS_DETOUR();
+
 	if (m_VR->m_OverrideEyeAngles) {
 		int localIndex = m_Game->m_EngineClient->GetLocalPlayer();
 		int index = EntityIndex(ecx);
@@ -911,13 +1015,19 @@ QAngle& __fastcall Hooks::dEyeAngles(void* ecx, void* edx) {
 }
 
 int __fastcall Hooks::dGetDefaultFOV(void* ecx, void* edx) {
+	HOOK_STATS_DETOUR();
+
 	return m_VR->m_Fov;
 }
 
 double __fastcall Hooks::dGetFOV(void* ecx, void* edx) {
+	HOOK_STATS_DETOUR();
+
 	return m_VR->m_Fov;
 }
 
 double __fastcall Hooks::dGetViewModelFOV(void* ecx, void* edx) {
+	HOOK_STATS_DETOUR();
+
 	return m_VR->m_Fov;
 }
\ No newline at end of file
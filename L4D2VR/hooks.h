@@ -1,7 +1,10 @@
 #pragma once
 #include <iostream>
+#include <vector>
 #include "MinHook.h"
 #include "bitbuf.h"
+#include "offsettable.h"
+#include "hookstats.h"
 
 class Game;
 class VR;
@@ -22,11 +25,21 @@ class bf_write;
 class bf_read;
 
 
-template <typename T>
-struct Hook {
-	T fOriginal;
+// The part of a hook that doesn't depend on its function type, so hooks can be batched
+struct HookBase {
 	LPVOID pTarget;
 	bool isEnabled;
+	// Not retried, the error was already shown
+	bool createFailed;
+};
+
+template <typename T>
+struct Hook : HookBase {
+#ifdef HOOK_STATS
+	HookStats::Original<T> fOriginal;
+#else
+	T fOriginal;
+#endif
 
 	int createHook(LPVOID targetFunc, LPVOID detourFunc)
 	{
@@ -38,6 +51,7 @@ struct Hook {
 			return 1;
 		}
 		pTarget = targetFunc;
+		return 0;
 	}
 
 	int enableHook()
@@ -54,6 +68,7 @@ struct Hook {
 			return 1;
 		}
 		isEnabled = true;
+		return 0;
 	}
 
 	int disableHook()
@@ -64,9 +79,72 @@ struct Hook {
 			return 1;
 		}
 		isEnabled = false;
+		return 0;
 	}
 };
 
+// Enables and disables several hooks at once. MH_EnableHook and MH_DisableHook suspend every
+// other thread of the game each time, applying a batch does it once for all of its hooks.
+class HookBatch
+{
+public:
+	HookBatch &enable(HookBase &hook)
+	{
+		m_Changes.push_back({ &hook, true });
+		return *this;
+	}
+
+	HookBatch &disable(HookBase &hook)
+	{
+		m_Changes.push_back({ &hook, false });
+		return *this;
+	}
+
+	// Hooks that can't be queued are reported and left out, the rest are still applied
+	int apply();
+
+private:
+	struct Change
+	{
+		HookBase *hook;
+		bool enable;
+	};
+
+	std::vector<Change> m_Changes;
+};
+
+// Features that can be switched on and off on their own
+enum class HookGroup
+{
+	Rendering,
+	Input,
+	Aiming,
+	Portalling,
+	Crosshair,
+	Hud,
+	Grabbables,
+	PortalGunVFX,
+	LaserPointer,
+	Count
+};
+
+// One row of Hooks::HookTable, create places the typed hook at the offset with its detour
+struct HookEntry
+{
+	const char *name;
+	const Offset *offset;
+	HookBase *hook;
+	int (*create)(LPVOID target);
+	HookGroup group;
+	bool enabledByDefault;
+};
+
+template <auto &hook, auto detour>
+constexpr HookEntry MakeHookEntry(const char *name, const Offset &offset, HookGroup group, bool enabledByDefault)
+{
+	return { name, &offset, &hook, [](LPVOID target) { return hook.createHook(target, (LPVOID)detour); }, group, enabledByDefault };
+}
+
 
 // Source Engine functions
 typedef ITexture *(__thiscall *tGetRenderTarget)(void *thisptr);
@@ -217,6 +295,10 @@ public:
 
 	int initSourceHooks();
 
+	// Creates the group's hooks the first time it's enabled, then enables or disables all of them at once
+	static int setGroupEnabled(HookGroup group, bool enabled);
+	static void printHookStatus();
+
 	// Detour functions
 	static ITexture *__fastcall dGetRenderTarget(void *ecx, void *edx);
 	static void __fastcall dRenderView(void *ecx, void *edx, CViewSetup &setup, CViewSetup &hudViewSetup, int nClearFlags, int whatToDraw);
@@ -303,5 +385,49 @@ public:
 	static inline tUTIL_Portal_AngleTransform UTIL_Portal_AngleTransform;
 	static inline tEntindex EntityIndex;
 	static inline tGetOwner GetOwner;
-	static inline tGetFullScreenTexture GetFullScreenTexture;
+
+	// Hooks are only created once they're first enabled, so a disabled hook never resolves its offset.
+	// Adding a hook only takes a row here.
+	static constexpr HookEntry HookTable[] = {
+		MakeHookEntry<hkRenderView, &dRenderView>("RenderView", OffsetTable::RenderView, HookGroup::Rendering, true),
+		MakeHookEntry<hkCalcViewModelView, &dCalcViewModelView>("CalcViewModelView", OffsetTable::CalcViewModelView, HookGroup::Rendering, true),
+		MakeHookEntry<hkEyePosition, &dEyePosition>("EyePosition", OffsetTable::EyePosition, HookGroup::Rendering, true),
+
+		MakeHookEntry<hkProcessUsercmds, &dProcessUsercmds>("ProcessUsercmds", OffsetTable::ProcessUsercmds, HookGroup::Input, true),
+		MakeHookEntry<hkReadUsercmd, &dReadUsercmd>("ReadUsercmd", OffsetTable::ReadUserCmd, HookGroup::Input, true),
+		MakeHookEntry<hkWriteUsercmd, &dWriteUsercmd>("WriteUsercmd", OffsetTable::WriteUsercmd, HookGroup::Input, true),
+		MakeHookEntry<hkCreateMove, &dCreateMove>("CreateMove", OffsetTable::CreateMove, HookGroup::Input, true),
+
+		MakeHookEntry<hkWeapon_ShootPosition, &dWeapon_ShootPosition>("Weapon_ShootPosition", OffsetTable::Weapon_ShootPosition, HookGroup::Aiming, true),
+		MakeHookEntry<hkTraceFirePortal, &dTraceFirePortal>("TraceFirePortal", OffsetTable::TraceFirePortalServer, HookGroup::Aiming, true),
+		MakeHookEntry<hkCWeaponPortalgun_FirePortal, &dCWeaponPortalgun_FirePortal>("CWeaponPortalgun_FirePortal", OffsetTable::CWeaponPortalgun_FirePortal, HookGroup::Aiming, true),
+
+		MakeHookEntry<hkPlayerPortalled, &dPlayerPortalled>("PlayerPortalled", OffsetTable::PlayerPortalled, HookGroup::Portalling, true),
+
+		MakeHookEntry<hkDrawSelf, &dDrawSelf>("DrawSelf", OffsetTable::DrawSelf, HookGroup::Crosshair, true),
+		MakeHookEntry<hkClipTransform, &dClipTransform>("ClipTransform", OffsetTable::ClipTransform, HookGroup::Crosshair, false),
+
+		MakeHookEntry<hkPushRenderTargetAndViewport, &dPushRenderTargetAndViewport>("PushRenderTargetAndViewport", OffsetTable::PushRenderTargetAndViewport, HookGroup::Hud, false),
+		MakeHookEntry<hkPopRenderTargetAndViewport, &dPopRenderTargetAndViewport>("PopRenderTargetAndViewport", OffsetTable::PopRenderTargetAndViewport, HookGroup::Hud, false),
+		MakeHookEntry<hkPrePushRenderTarget, &dPrePushRenderTarget>("PrePushRenderTarget", OffsetTable::PrePushRenderTarget, HookGroup::Hud, false),
+		MakeHookEntry<hkVgui_Paint, &dVGui_Paint>("VGui_Paint", OffsetTable::VGui_Paint, HookGroup::Hud, false),
+		MakeHookEntry<hkGetFullScreenTexture, &dGetFullScreenTexture>("GetFullScreenTexture", OffsetTable::GetFullScreenTexture, HookGroup::Hud, false),
+
+		MakeHookEntry<hkUpdateObject, &dUpdateObject>("UpdateObject", OffsetTable::UpdateObject, HookGroup::Grabbables, true),
+		MakeHookEntry<hkUpdateObjectVM, &dUpdateObjectVM>("UpdateObjectVM", OffsetTable::UpdateObjectVM, HookGroup::Grabbables, true),
+		MakeHookEntry<hkEyeAngles, &dEyeAngles>("EyeAngles", OffsetTable::EyeAngles, HookGroup::Grabbables, true),
+		MakeHookEntry<hkComputeError, &dComputeError>("ComputeError", OffsetTable::ComputeError, HookGroup::Grabbables, false),
+		MakeHookEntry<hkRotateObject, &dRotateObject>("RotateObject", OffsetTable::RotateObject, HookGroup::Grabbables, false),
+
+		MakeHookEntry<hkGetDefaultFOV, &dGetDefaultFOV>("GetDefaultFOV", OffsetTable::GetDefaultFOV, HookGroup::PortalGunVFX, true),
+		MakeHookEntry<hkGetFOV, &dGetFOV>("GetFOV", OffsetTable::GetFOV, HookGroup::PortalGunVFX, true),
+		MakeHookEntry<hkGetViewModelFOV, &dGetViewModelFOV>("GetViewModelFOV", OffsetTable::GetViewModelFOV, HookGroup::PortalGunVFX, true),
+
+		MakeHookEntry<hkPrecache, &dPrecache>("Precache", OffsetTable::Precache, HookGroup::LaserPointer, true),
+		MakeHookEntry<hkSetDrawOnlyForSplitScreenUser, &dSetDrawOnlyForSplitScreenUser>("SetDrawOnlyForSplitScreenUser", OffsetTable::SetDrawOnlyForSplitScreenUser, HookGroup::LaserPointer, true),
+		MakeHookEntry<hkCHudCrosshair_ShouldDraw, &dCHudCrosshair_ShouldDraw>("CHudCrosshair_ShouldDraw", OffsetTable::CHudCrosshair_ShouldDraw, HookGroup::LaserPointer, true),
+	};
+
+private:
+	static bool createFromTable(const HookEntry &entry);
 };
\ No newline at end of file
@@ -0,0 +1,362 @@
+#pragma once
+// Call counts and latency histograms for the detours, split into the detour's own time and the
+// time spent in the original function. Only built with HOOK_STATS defined, otherwise the macros
+// are empty and Hook::fOriginal is a plain function pointer.
+//
+// HOOK_STATS_DETOUR() goes first in a detour. Calls through Hook::fOriginal count as the original's
+// time of the innermost detour running on that thread. Per-frame rows are only written to
+// FrameLogPath after HOOK_STATS_LOG_FRAMES(true), which the LogHookStats config key sets.
+
+#ifdef HOOK_STATS
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define HOOK_STATS_RDTSC
+#endif
+
+namespace HookStats
+{
+	// Bucket i counts calls that took less than 2^(i+1) ticks
+	constexpr int Buckets = 32;
+	constexpr int MaxDetours = 64;
+
+	// Per-frame rows, relative to the game directory
+	static constexpr const char *FrameLogPath = "VR\\hookstats.csv";
+
+	inline uint64_t Now()
+	{
+#ifdef HOOK_STATS_RDTSC
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	inline int Bucket(uint64_t ticks)
+	{
+		int bucket = 0;
+		while (ticks > 1 && bucket < Buckets - 1)
+		{
+			ticks >>= 1;
+			++bucket;
+		}
+		return bucket;
+	}
+
+	// Only ever written by the thread owning it, so it needs no lock or atomic add, the atomic
+	// just makes reading it from another thread safe
+	struct Counter
+	{
+		std::atomic<uint64_t> value{ 0 };
+
+		void Add(uint64_t amount)
+		{
+			value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		uint64_t Get() const { return value.load(std::memory_order_relaxed); }
+	};
+
+	struct DetourCounters
+	{
+		Counter calls;
+		Counter selfTicks;
+		Counter originalTicks;
+		Counter self[Buckets];
+		Counter original[Buckets];
+	};
+
+	struct ThreadBuffer
+	{
+		DetourCounters detours[MaxDetours];
+	};
+
+	// Sum over all threads
+	struct DetourTotals
+	{
+		std::string name;
+		uint64_t calls = 0;
+		uint64_t selfTicks = 0;
+		uint64_t originalTicks = 0;
+		uint64_t self[Buckets] = {};
+		uint64_t original[Buckets] = {};
+	};
+
+	struct Report
+	{
+		std::vector<DetourTotals> detours;
+		double ticksPerUs = 1;
+
+		double Us(uint64_t ticks) const { return ticks / ticksPerUs; }
+	};
+
+	class Registry
+	{
+	public:
+		static Registry &Get()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		// -1 once MaxDetours are registered, those detours aren't counted
+		int Register(const char *name)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Names.size() == MaxDetours)
+				return -1;
+			m_Names.push_back(name);
+			return (int)m_Names.size() - 1;
+		}
+
+		DetourCounters &Local(int id)
+		{
+			thread_local ThreadBuffer *buffer = AddThread();
+			return buffer->detours[id];
+		}
+
+		Report Collect()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			Report report;
+			report.ticksPerUs = TicksPerUs();
+			report.detours.resize(m_Names.size());
+			for (size_t i = 0; i < m_Names.size(); ++i)
+			{
+				DetourTotals &totals = report.detours[i];
+				totals.name = m_Names[i];
+				for (const std::unique_ptr<ThreadBuffer> &thread : m_Threads)
+				{
+					const DetourCounters &counters = thread->detours[i];
+					totals.calls += counters.calls.Get();
+					totals.selfTicks += counters.selfTicks.Get();
+					totals.originalTicks += counters.originalTicks.Get();
+					for (int bucket = 0; bucket < Buckets; ++bucket)
+					{
+						totals.self[bucket] += counters.self[bucket].Get();
+						totals.original[bucket] += counters.original[bucket].Get();
+					}
+				}
+			}
+			return report;
+		}
+
+		// Safe from any thread, the log is opened and closed by the thread calling EndFrame
+		void SetFrameLog(bool enabled)
+		{
+			m_LogFrames = enabled;
+		}
+
+		// Stats of the frame that just ended, call once per frame
+		void EndFrame()
+		{
+			Report now = Collect();
+			Report frame = now;
+			for (size_t i = 0; i < frame.detours.size() && i < m_FrameStart.detours.size(); ++i)
+			{
+				DetourTotals &totals = frame.detours[i];
+				const DetourTotals &before = m_FrameStart.detours[i];
+				totals.calls -= before.calls;
+				totals.selfTicks -= before.selfTicks;
+				totals.originalTicks -= before.originalTicks;
+				for (int bucket = 0; bucket < Buckets; ++bucket)
+				{
+					totals.self[bucket] -= before.self[bucket];
+					totals.original[bucket] -= before.original[bucket];
+				}
+			}
+			if (m_LogFrames)
+			{
+				WriteFrame(frame);
+			}
+			else if (m_FrameLog.is_open())
+			{
+				m_FrameLog.close();
+				std::cout << "Wrote hook stats to " << FrameLogPath << "\n";
+			}
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_FrameStart = std::move(now);
+			m_LastFrame = std::move(frame);
+			++m_Frame;
+		}
+
+		Report LastFrame()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return m_LastFrame;
+		}
+
+		// Totals since startup, with the histograms
+		void PrintSession()
+		{
+			Report report = Collect();
+			std::cout << "Hook stats, " << m_Frame.load() << " frames:\n";
+			for (const DetourTotals &totals : report.detours)
+			{
+				if (!totals.calls)
+					continue;
+
+				std::cout << "  " << totals.name << ": " << totals.calls << " calls, self "
+					<< report.Us(totals.selfTicks) / totals.calls << " us, original "
+					<< report.Us(totals.originalTicks) / totals.calls << " us avg\n";
+				PrintHistogram("self", totals.self, report);
+				PrintHistogram("original", totals.original, report);
+			}
+		}
+
+	private:
+		std::mutex m_Mutex;
+		std::vector<const char *> m_Names;
+		// Never freed, a thread's counts stay readable after it exits
+		std::vector<std::unique_ptr<ThreadBuffer>> m_Threads;
+
+		uint64_t m_StartTicks = Now();
+		std::chrono::steady_clock::time_point m_StartTime = std::chrono::steady_clock::now();
+
+		Report m_FrameStart;
+		Report m_LastFrame;
+		std::atomic<uint64_t> m_Frame{ 0 };
+		std::atomic<bool> m_LogFrames{ false };
+		std::ofstream m_FrameLog;
+
+		ThreadBuffer *AddThread()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Threads.push_back(std::make_unique<ThreadBuffer>());
+			return m_Threads.back().get();
+		}
+
+		// The TSC rate isn't known up front, it's measured against the clock over the whole session
+		double TicksPerUs() const
+		{
+#ifdef HOOK_STATS_RDTSC
+			double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_StartTime).count();
+			return us > 0 ? (Now() - m_StartTicks) / us : 1;
+#else
+			return 1000;
+#endif
+		}
+
+		void WriteFrame(const Report &frame)
+		{
+			if (!m_FrameLog.is_open())
+			{
+				m_FrameLog.open(FrameLogPath);
+				m_FrameLog << "frame,detour,calls,self us,original us\n";
+			}
+
+			for (const DetourTotals &totals : frame.detours)
+			{
+				if (totals.calls)
+					m_FrameLog << m_Frame.load() << "," << totals.name << "," << totals.calls << "," << frame.Us(totals.selfTicks) << "," << frame.Us(totals.originalTicks) << "\n";
+			}
+		}
+
+		static void PrintHistogram(const char *label, const uint64_t (&buckets)[Buckets], const Report &report)
+		{
+			std::cout << "    " << label << ":";
+			for (int bucket = 0; bucket < Buckets; ++bucket)
+			{
+				if (buckets[bucket])
+					std::cout << " <" << report.Us(2ull << bucket) << "us:" << buckets[bucket];
+			}
+			std::cout << "\n";
+		}
+	};
+
+	class DetourScope;
+	inline thread_local DetourScope *t_Current = nullptr;
+
+	// Times a detour from construction to destruction
+	class DetourScope
+	{
+	public:
+		DetourScope(int id)
+			: m_Id(id), m_Parent(t_Current), m_Start(Now())
+		{
+			t_Current = this;
+		}
+
+		~DetourScope()
+		{
+			t_Current = m_Parent;
+			if (m_Id < 0)
+				return;
+
+			uint64_t total = Now() - m_Start;
+			uint64_t self = total > m_OriginalTicks ? total - m_OriginalTicks : 0;
+			DetourCounters &counters = Registry::Get().Local(m_Id);
+			counters.calls.Add(1);
+			counters.selfTicks.Add(self);
+			counters.originalTicks.Add(m_OriginalTicks);
+			counters.self[Bucket(self)].Add(1);
+			if (m_OriginalTicks)
+				counters.original[Bucket(m_OriginalTicks)].Add(1);
+		}
+
+		void AddOriginal(uint64_t ticks) { m_OriginalTicks += ticks; }
+
+	private:
+		int m_Id;
+		DetourScope *m_Parent;
+		uint64_t m_Start;
+		uint64_t m_OriginalTicks = 0;
+	};
+
+	// Stands in for the trampoline in Hook::fOriginal, calls go through it unchanged
+	template <typename T>
+	struct Original
+	{
+		T function;
+
+		template <typename... Args>
+		decltype(auto) operator()(Args &&...args) const
+		{
+			struct Timer
+			{
+				DetourScope *scope = t_Current;
+				uint64_t start = Now();
+				~Timer()
+				{
+					if (scope)
+						scope->AddOriginal(Now() - start);
+				}
+			} timer;
+			return function(std::forward<Args>(args)...);
+		}
+	};
+
+	inline Report Session() { return Registry::Get().Collect(); }
+	inline Report LastFrame() { return Registry::Get().LastFrame(); }
+}
+
+#define HOOK_STATS_DETOUR() \
+	static const int hookStatsId = HookStats::Registry::Get().Register(__FUNCTION__); \
+	HookStats::DetourScope hookStatsScope(hookStatsId)
+#define HOOK_STATS_END_FRAME() HookStats::Registry::Get().EndFrame()
+#define HOOK_STATS_LOG_FRAMES(enabled) HookStats::Registry::Get().SetFrameLog(enabled)
+#define HOOK_STATS_PRINT_SESSION() HookStats::Registry::Get().PrintSession()
+
+#else
+
+#define HOOK_STATS_DETOUR() ((void)0)
+#define HOOK_STATS_END_FRAME() ((void)0)
+#define HOOK_STATS_LOG_FRAMES(enabled) ((void)(enabled))
+#define HOOK_STATS_PRINT_SESSION() ((void)0)
+
+#endif
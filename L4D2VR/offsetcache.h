@@ -0,0 +1,356 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include "peimage.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 64-bit multiply/rotate hash, 8 bytes per step. Only used to detect changed module code, not
+// for anything security related.
+inline uint64_t FastHash64(const uint8_t *data, size_t size, uint64_t seed = 0)
+{
+	auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+	const uint64_t c1 = 0x87C37B91114253D5ull;
+	const uint64_t c2 = 0x4CF5AD432745937Full;
+
+	uint64_t h = seed ^ (size * c1);
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t k;
+		memcpy(&k, data + i, 8);
+		h ^= rotl(k * c1, 31) * c2;
+		h = rotl(h, 27) * 5 + 0x52DCE729;
+	}
+
+	uint64_t tail = 0;
+	memcpy(&tail, data + i, size - i);
+	h ^= rotl(tail * c1, 31) * c2;
+
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+inline uint64_t FastHash64(const std::string &str, uint64_t seed = 0)
+{
+	return FastHash64((const uint8_t *)str.data(), str.size(), seed);
+}
+
+// Identifies one build of a module. Any game update changes at least one of these.
+struct ModuleIdentity
+{
+	char name[32] = {};
+	uint32_t timeDateStamp = 0;
+	uint32_t sizeOfImage = 0;
+	uint64_t textHash = 0;
+
+	bool operator==(const ModuleIdentity &other) const
+	{
+		return strcmp(name, other.name) == 0 && timeDateStamp == other.timeDateStamp &&
+			sizeOfImage == other.sizeOfImage && textHash == other.textHash;
+	}
+
+	// Hashes .text with every relocated address zeroed out, so the identity doesn't change
+	// when the module gets loaded at a different base address.
+	// Works on both a loaded module and a DLL read from disk and gives the same identity for either.
+	static bool FromImage(const std::string &moduleName, const PEImage &pe, ModuleIdentity &out)
+	{
+		const PESection *text = pe.FindSection(".text");
+		if (!text)
+			return false;
+
+		// Anything past the end of the raw data reads as zeros, like it does once loaded
+		ImageRegion region = pe.SectionRegion(*text);
+		std::vector<uint8_t> code(std::max(text->virtualSize, (uint32_t)region.size), 0);
+		memcpy(code.data(), region.data, region.size);
+
+		pe.ForEachRelocation([&](uint32_t rva, int width)
+		{
+			if (rva >= text->virtualAddress && rva + width <= text->virtualAddress + code.size())
+				memset(code.data() + (rva - text->virtualAddress), 0, width);
+		});
+
+		out = ModuleIdentity();
+		strncpy(out.name, moduleName.c_str(), sizeof(out.name) - 1);
+		out.timeDateStamp = pe.m_TimeDateStamp;
+		out.sizeOfImage = pe.m_SizeOfImage;
+		out.textHash = FastHash64(code.data(), code.size());
+		return true;
+	}
+};
+
+static_assert(sizeof(ModuleIdentity) == 48, "ModuleIdentity is written to the offset cache as is");
+
+// Read-only view of a whole file, memory-mapped where possible.
+class MappedFile
+{
+public:
+	const uint8_t *m_Data = nullptr;
+	size_t m_Size = 0;
+
+	MappedFile() {};
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	~MappedFile() { Close(); }
+
+	bool Open(const std::string &path)
+	{
+		Close();
+#ifdef _WIN32
+		m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_File == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		m_Mapping = NULL;
+		if (GetFileSizeEx(m_File, &fileSize) && fileSize.QuadPart != 0)
+			m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		if (m_Mapping)
+		{
+			m_Data = (const uint8_t *)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+			m_Size = (size_t)fileSize.QuadPart;
+		}
+#else
+		m_File = open(path.c_str(), O_RDONLY);
+		if (m_File < 0)
+			return false;
+
+		struct stat st;
+		if (fstat(m_File, &st) == 0 && st.st_size != 0)
+		{
+			void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, m_File, 0);
+			m_Data = data == MAP_FAILED ? nullptr : (const uint8_t *)data;
+			m_Size = (size_t)st.st_size;
+		}
+#endif
+		if (!m_Data)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (m_Data)
+			UnmapViewOfFile(m_Data);
+		if (m_Mapping)
+			CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE)
+			CloseHandle(m_File);
+		m_Mapping = NULL;
+		m_File = INVALID_HANDLE_VALUE;
+#else
+		if (m_Data)
+			munmap((void *)m_Data, m_Size);
+		if (m_File >= 0)
+			close(m_File);
+		m_File = -1;
+#endif
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE m_File = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping = NULL;
+#else
+	int m_File = -1;
+#endif
+};
+
+// Resolved offsets from previous launches, stored in VR\offsets.cache.
+// Entries are grouped per module build; a module whose identity changed (game update) loses
+// all of its entries the next time an offset for it is stored.
+class OffsetCache
+{
+public:
+	static constexpr uint32_t Magic = 0x4F565032; // "2PVO"
+	static constexpr uint32_t Version = 1;
+
+	struct Entry
+	{
+		uint32_t module;
+		int32_t offset;
+		uint64_t signatureKey;
+	};
+
+	static_assert(sizeof(Entry) == 16, "Entry is written to the offset cache as is");
+
+	std::vector<ModuleIdentity> m_Modules;
+	std::vector<Entry> m_Entries;
+	bool m_Dirty = false;
+
+	// Key for one Offset, a changed signature or sigOffset never reuses an old entry
+	static uint64_t SignatureKey(const std::string &signature, int sigOffset)
+	{
+		return FastHash64(signature, (uint64_t)(uint32_t)sigOffset);
+	}
+
+	bool Load(const std::string &path)
+	{
+		MappedFile file;
+		if (!file.Open(path))
+			return false;
+		return Parse(file.m_Data, file.m_Size);
+	}
+
+	// Rejects anything truncated, from another version or with out of range module indices.
+	bool Parse(const uint8_t *data, size_t size)
+	{
+		m_Modules.clear();
+		m_Entries.clear();
+		m_Dirty = false;
+
+		uint32_t header[4];
+		if (size < sizeof(header))
+			return false;
+		memcpy(header, data, sizeof(header));
+
+		const uint32_t moduleCount = header[2], entryCount = header[3];
+		if (header[0] != Magic || header[1] != Version ||
+			size != sizeof(header) + (size_t)moduleCount * sizeof(ModuleIdentity) + (size_t)entryCount * sizeof(Entry))
+			return false;
+
+		const uint8_t *p = data + sizeof(header);
+		m_Modules.resize(moduleCount);
+		memcpy(m_Modules.data(), p, moduleCount * sizeof(ModuleIdentity));
+		p += moduleCount * sizeof(ModuleIdentity);
+
+		m_Entries.resize(entryCount);
+		memcpy(m_Entries.data(), p, entryCount * sizeof(Entry));
+
+		for (ModuleIdentity &module : m_Modules)
+			module.name[sizeof(module.name) - 1] = 0;
+
+		for (const Entry &entry : m_Entries)
+		{
+			if (entry.module >= moduleCount)
+			{
+				m_Modules.clear();
+				m_Entries.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::vector<uint8_t> Serialize() const
+	{
+		const uint32_t header[4] = { Magic, Version, (uint32_t)m_Modules.size(), (uint32_t)m_Entries.size() };
+
+		std::vector<uint8_t> data(sizeof(header) + m_Modules.size() * sizeof(ModuleIdentity) + m_Entries.size() * sizeof(Entry));
+		uint8_t *p = data.data();
+		memcpy(p, header, sizeof(header));
+		p += sizeof(header);
+		memcpy(p, m_Modules.data(), m_Modules.size() * sizeof(ModuleIdentity));
+		p += m_Modules.size() * sizeof(ModuleIdentity);
+		memcpy(p, m_Entries.data(), m_Entries.size() * sizeof(Entry));
+		return data;
+	}
+
+	// Writes to a temporary file first and renames it over the old cache, so a crash mid-write
+	// never leaves a half written cache behind.
+	bool Save(const std::string &path) const
+	{
+		const std::string tempPath = path + ".tmp";
+		std::vector<uint8_t> data = Serialize();
+
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			if (!out.write((const char *)data.data(), data.size()))
+				return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+		return !error;
+	}
+
+	// Returns the cached offset, or -1 if this module build has no entry for the signature.
+	int Find(const ModuleIdentity &module, uint64_t signatureKey) const
+	{
+		int moduleIndex = FindModule(module);
+		if (moduleIndex < 0)
+			return -1;
+
+		for (const Entry &entry : m_Entries)
+		{
+			if (entry.module == (uint32_t)moduleIndex && entry.signatureKey == signatureKey)
+				return entry.offset;
+		}
+		return -1;
+	}
+
+	void Store(const ModuleIdentity &module, uint64_t signatureKey, int offset)
+	{
+		int moduleIndex = FindModule(module);
+		if (moduleIndex < 0)
+			moduleIndex = ReplaceModule(module);
+
+		for (Entry &entry : m_Entries)
+		{
+			if (entry.module == (uint32_t)moduleIndex && entry.signatureKey == signatureKey)
+			{
+				m_Dirty |= entry.offset != offset;
+				entry.offset = offset;
+				return;
+			}
+		}
+
+		m_Entries.push_back({ (uint32_t)moduleIndex, offset, signatureKey });
+		m_Dirty = true;
+	}
+
+private:
+	int FindModule(const ModuleIdentity &module) const
+	{
+		for (size_t i = 0; i < m_Modules.size(); ++i)
+		{
+			if (m_Modules[i] == module)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	// Drops everything cached for an older build of the same module.
+	int ReplaceModule(const ModuleIdentity &module)
+	{
+		m_Dirty = true;
+
+		for (size_t i = 0; i < m_Modules.size(); ++i)
+		{
+			if (strcmp(m_Modules[i].name, module.name) != 0)
+				continue;
+
+			m_Modules[i] = module;
+			m_Entries.erase(std::remove_if(m_Entries.begin(), m_Entries.end(),
+				[&](const Entry &entry) { return entry.module == (uint32_t)i; }), m_Entries.end());
+			return (int)i;
+		}
+
+		m_Modules.push_back(module);
+		return (int)m_Modules.size() - 1;
+	}
+};
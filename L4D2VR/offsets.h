@@ -1,142 +1,720 @@
 #pragma once
+#include <map>
+#include <iostream>
+#include <chrono>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "offsettable.h"
 #include "sigscanner.h"
+#include "offsetcache.h"
+#include "threadpool.h"
 #include "game.h"
 
 
-struct Offset
+class Offsets;
+
+// Handle to one OffsetTable entry. The signature is resolved the first time Address() is called,
+// unless Offsets::WarmUp already got to it.
+class ResolvedOffset
 {
-    std::string moduleName;
-    int offset;
-    int address;
-    std::string signature;
-    int sigOffset;
+public:
+    const Offset *info = nullptr;
+
+    // Blocks while the offset is being resolved, 0 if it couldn't be found. An offset whose module
+    // isn't loaded yet is also 0 and is tried again on the next call.
+    int Address();
+
+    bool IsResolved() const { return m_State.load(std::memory_order_acquire) == Resolved; }
+
+private:
+    friend class Offsets;
+
+    enum State
+    {
+        Unresolved,
+        Resolving,
+        Resolved
+    };
+
+    Offsets *m_Owner = nullptr;
+    // Where the signature matched plus sigOffset, what gets cached
+    int m_Offset = 0;
+    // After the resolve steps
+    uint32_t m_Rva = 0;
+    int m_Address = 0;
+    std::atomic<int> m_State = Unresolved;
+};
+
+class Offsets
+{
+public:
+    static constexpr size_t Count = std::size(OffsetTable::All);
+
+    // Same order as OffsetTable::All
+    ResolvedOffset m_Resolved[Count];
+
+    ResolvedOffset &GetFullScreenTexture = Get<OffsetTable::GetFullScreenTexture>();
+    ResolvedOffset &RenderView = Get<OffsetTable::RenderView>();
+    ResolvedOffset &g_pClientMode = Get<OffsetTable::g_pClientMode>();
+    ResolvedOffset &CalcViewModelView = Get<OffsetTable::CalcViewModelView>();
+    ResolvedOffset &CreateMove = Get<OffsetTable::CreateMove>();
+    ResolvedOffset &WriteUsercmd = Get<OffsetTable::WriteUsercmd>();
+    ResolvedOffset &g_pppInput = Get<OffsetTable::g_pppInput>();
+    ResolvedOffset &PrePushRenderTarget = Get<OffsetTable::PrePushRenderTarget>();
+    ResolvedOffset &ReadUserCmd = Get<OffsetTable::ReadUserCmd>();
+    ResolvedOffset &ProcessUsercmds = Get<OffsetTable::ProcessUsercmds>();
+    ResolvedOffset &CBaseEntity_entindex = Get<OffsetTable::CBaseEntity_entindex>();
+    ResolvedOffset &EyePosition = Get<OffsetTable::EyePosition>();
+    ResolvedOffset &PushRenderTargetAndViewport = Get<OffsetTable::PushRenderTargetAndViewport>();
+    ResolvedOffset &PopRenderTargetAndViewport = Get<OffsetTable::PopRenderTargetAndViewport>();
+    ResolvedOffset &TraceFirePortalServer = Get<OffsetTable::TraceFirePortalServer>();
+    ResolvedOffset &CWeaponPortalgun_FirePortal = Get<OffsetTable::CWeaponPortalgun_FirePortal>();
+    ResolvedOffset &VGui_Paint = Get<OffsetTable::VGui_Paint>();
+    ResolvedOffset &PlayerPortalled = Get<OffsetTable::PlayerPortalled>();
+    ResolvedOffset &DrawSelf = Get<OffsetTable::DrawSelf>();
+    ResolvedOffset &ClipTransform = Get<OffsetTable::ClipTransform>();
+    ResolvedOffset &VGui_GetClientDLLRootPanel = Get<OffsetTable::VGui_GetClientDLLRootPanel>();
+    ResolvedOffset &g_pFullscreenRootPanel = Get<OffsetTable::g_pFullscreenRootPanel>();
+    ResolvedOffset &CreatePingPointer = Get<OffsetTable::CreatePingPointer>();
+    ResolvedOffset &GetPortalPlayer = Get<OffsetTable::GetPortalPlayer>();
+    ResolvedOffset &PrecacheParticleSystem = Get<OffsetTable::PrecacheParticleSystem>();
+    ResolvedOffset &Precache = Get<OffsetTable::Precache>();
+    ResolvedOffset &SetControlPoint = Get<OffsetTable::SetControlPoint>();
+    ResolvedOffset &SetDrawOnlyForSplitScreenUser = Get<OffsetTable::SetDrawOnlyForSplitScreenUser>();
+    ResolvedOffset &StopEmission = Get<OffsetTable::StopEmission>();
+    ResolvedOffset &CHudCrosshair_ShouldDraw = Get<OffsetTable::CHudCrosshair_ShouldDraw>();
+    ResolvedOffset &UTIL_Portal_FirstAlongRay = Get<OffsetTable::UTIL_Portal_FirstAlongRay>();
+    ResolvedOffset &UTIL_IntersectRayWithPortal = Get<OffsetTable::UTIL_IntersectRayWithPortal>();
+    ResolvedOffset &UTIL_Portal_AngleTransform = Get<OffsetTable::UTIL_Portal_AngleTransform>();
+    ResolvedOffset &Weapon_ShootPosition = Get<OffsetTable::Weapon_ShootPosition>();
+    ResolvedOffset &ComputeError = Get<OffsetTable::ComputeError>();
+    ResolvedOffset &UpdateObject = Get<OffsetTable::UpdateObject>();
+    ResolvedOffset &UpdateObjectVM = Get<OffsetTable::UpdateObjectVM>();
+    ResolvedOffset &RotateObject = Get<OffsetTable::RotateObject>();
+    ResolvedOffset &EyeAngles = Get<OffsetTable::EyeAngles>();
+    ResolvedOffset &MatrixBuildPerspectiveX = Get<OffsetTable::MatrixBuildPerspectiveX>();
+    ResolvedOffset &GetFOV = Get<OffsetTable::GetFOV>();
+    ResolvedOffset &GetDefaultFOV = Get<OffsetTable::GetDefaultFOV>();
+    ResolvedOffset &GetViewModelFOV = Get<OffsetTable::GetViewModelFOV>();
+    ResolvedOffset &GetOwner = Get<OffsetTable::GetOwner>();
+
+    template <const Offset &offset>
+    ResolvedOffset &Get()
+    {
+        static_assert(IndexOf(offset) < Count, "Offset is missing from OffsetTable::All");
+        return m_Resolved[IndexOf(offset)];
+    }
+
+    // For offsets picked at runtime, e.g. from a table. The offset has to be in OffsetTable::All.
+    ResolvedOffset &Get(const Offset &offset)
+    {
+        return m_Resolved[IndexOf(offset)];
+    }
+
+    static constexpr size_t IndexOf(const Offset &offset)
+    {
+        for (size_t i = 0; i < Count; ++i)
+        {
+            if (OffsetTable::All[i] == &offset)
+                return i;
+        }
+        return Count;
+    }
 
-    Offset(std::string moduleName, int currentOffset, std::string signature, int sigOffset = 0)
+    // Number of offsets between an offset and the one whose signature it's reached from
+    static constexpr int Depth(const Offset &offset)
     {
-        this->moduleName = moduleName;
-        this->offset = currentOffset;
-        this->signature = signature;
-        this->sigOffset = sigOffset;
+        return offset.base ? Depth(*offset.base) + 1 : 0;
+    }
+
+    static constexpr bool BasesInTable()
+    {
+        for (const Offset *offset : OffsetTable::All)
+        {
+            if (offset->base && IndexOf(*offset->base) == Count)
+                return false;
+        }
+        return true;
+    }
+
+    static constexpr const char *CachePath = "VR\\offsets.cache";
+
+    // Where the game keeps its DLLs, relative to the game directory
+    static constexpr const char *BinDirs[] = { "bin\\", "portal2\\bin\\" };
+
+    // Sections bigger than this get scanned by several threads at once
+    static constexpr size_t ScanChunkSize = 1024 * 1024;
+
+    // Nothing is resolved here, only on first use or through WarmUp
+    Offsets()
+    {
+        static_assert(BasesInTable(), "Offset::From base is missing from OffsetTable::All");
+
+        m_Cache.Load(CachePath);
+
+        for (size_t i = 0; i < Count; ++i)
+        {
+            ResolvedOffset &offset = m_Resolved[i];
+            offset.info = OffsetTable::All[i];
+            offset.m_Owner = this;
+            offset.m_Offset = offset.info->offset;
+            m_Modules[offset.info->moduleName];
+        }
+    }
 
-        int newOffset = SigScanner::VerifyOffset(moduleName, currentOffset, signature, sigOffset);
-        if (newOffset > 0)
+    ~Offsets()
+    {
+        for (auto &[moduleName, fromDisk] : m_FromDisk)
+            fromDisk.wait();
+        for (std::future<void> &warmUp : m_WarmUps)
+            warmUp.wait();
+    }
+
+    // Scans the DLLs on disk in the background, before the game has loaded them, and puts what's
+    // found in the cache. As long as the file on disk is the build that gets loaded, resolving
+    // later on only has to check the cached offsets. Each module is scanned on its own, so resolving
+    // only ever waits for the modules it needs. Call before anything gets resolved.
+    template <size_t N>
+    void PreResolve(const Offset *const (&offsets)[N])
+    {
+        // Offsets reached from another one aren't cached, only their base is
+        std::map<std::string, std::vector<const Offset *>> modules;
+        for (const Offset *offset : offsets)
         {
-            this->offset = newOffset;
+            if (!offset->base)
+                modules[offset->moduleName].push_back(offset);
         }
-            
-        if (newOffset == -1)
+
+        for (auto &entry : modules)
         {
-            Game::errorMsg(("Signature not found: " + signature).c_str());
+            std::string moduleName = entry.first;
+            std::vector<const Offset *> list = entry.second;
+            m_FromDisk[moduleName] = std::async(std::launch::async, [this, moduleName, list] { ResolveFromDisk(moduleName, list); }).share();
+        }
+    }
+
+    // Resolves the given offsets together in the background. Anything accessed before that's done
+    // waits for it instead of scanning a second time.
+    template <size_t N>
+    void WarmUp(const Offset *const (&offsets)[N])
+    {
+        std::vector<ResolvedOffset *> batch = Claim(offsets, N);
+        if (batch.empty())
             return;
+
+        std::lock_guard<std::mutex> lock(m_StateMutex);
+        m_WarmUps.push_back(std::async(std::launch::async, [this, batch] { ResolveBatch(batch); }));
+    }
+
+    void Resolve(ResolvedOffset &offset)
+    {
+        const Offset *info = offset.info;
+        std::vector<ResolvedOffset *> batch = Claim(&info, 1);
+        if (!batch.empty())
+            ResolveBatch(batch);
+
+        // Whoever resolves it leaves it Resolved, or Unresolved if its module isn't loaded yet
+        std::unique_lock<std::mutex> lock(m_StateMutex);
+        m_StateChanged.wait(lock, [&] { return offset.m_State.load(std::memory_order_relaxed) != ResolvedOffset::Resolving; });
+    }
+
+private:
+    // A loaded module, prepared once and only read afterwards
+    struct ModuleImage
+    {
+        std::mutex mutex;
+        bool loaded = false;
+        const uint8_t *bytes = nullptr;
+        size_t size = 0;
+        PEImage image;
+        ModuleIdentity identity;
+        bool cacheable = false;
+
+        // Indexed by SectionKind
+        std::vector<ImageRegion> regions[3];
+    };
+
+    // One piece of a section, scanned by one job
+    struct ScanChunk
+    {
+        ImageRegion region;
+        size_t begin;
+        size_t end;
+        std::vector<PatternMatches> matches;
+        double ms = 0;
+    };
+
+    // The stale offsets that search the same kind of section
+    struct ScanPass
+    {
+        std::vector<ResolvedOffset *> offsets;
+        std::vector<const Pattern *> patterns;
+        std::vector<ScanChunk> chunks;
+    };
+
+    // The part of a batch that belongs to one module
+    struct ModuleBatch
+    {
+        std::string moduleName;
+        ModuleImage *module = nullptr;
+        bool loaded = false;
+        std::vector<ResolvedOffset *> offsets;
+
+        // Offsets from the cache or the hardcoded value that still match
+        std::vector<std::pair<ResolvedOffset *, int>> verified;
+
+        // Indexed by SectionKind
+        ScanPass passes[3];
+
+        double checkMs = 0;
+    };
+
+    // Keys are never added after construction, so lookups need no lock
+    std::map<std::string, ModuleImage> m_Modules;
+
+    OffsetCache m_Cache;
+    std::mutex m_CacheMutex;
+
+    // Guards the Unresolved -> Resolving -> Resolved transitions, and Resolving -> Unresolved when a module isn't loaded yet
+    std::mutex m_StateMutex;
+    std::condition_variable m_StateChanged;
+    std::vector<std::future<void>> m_WarmUps;
+    // Per module, filled in by PreResolve before anything is resolved and only read afterwards
+    std::map<std::string, std::shared_future<void>> m_FromDisk;
+
+    ThreadPool m_Pool;
+
+    // Marks every offset nobody is resolving yet as Resolving and returns them
+    std::vector<ResolvedOffset *> Claim(const Offset *const *offsets, size_t count)
+    {
+        std::vector<ResolvedOffset *> claimed;
+        std::lock_guard<std::mutex> lock(m_StateMutex);
+        for (size_t i = 0; i < count; ++i)
+        {
+            ResolvedOffset &offset = m_Resolved[IndexOf(*offsets[i])];
+            if (offset.m_State.load(std::memory_order_relaxed) != ResolvedOffset::Unresolved)
+                continue;
+
+            offset.m_State.store(ResolvedOffset::Resolving, std::memory_order_relaxed);
+            claimed.push_back(&offset);
+        }
+        return claimed;
+    }
+
+    // Resolves claimed offsets: modules are prepared in parallel, then every section that has to be
+    // scanned is split into chunks for the pool, and everything is merged in module order.
+    void ResolveBatch(const std::vector<ResolvedOffset *> &batch)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        // std::map keeps the module order and therefore the merge order fixed
+        std::map<std::string, ModuleBatch> modules;
+        std::vector<ResolvedOffset *> derived;
+        for (ResolvedOffset *offset : batch)
+        {
+            if (offset->info->base)
+                derived.push_back(offset);
+            else
+                modules[offset->info->moduleName].offsets.push_back(offset);
+        }
+
+        // A module still being scanned on disk is cheaper to wait for than to scan again, the other
+        // modules' scans don't hold this batch up
+        for (auto &[moduleName, module] : modules)
+        {
+            auto fromDisk = m_FromDisk.find(moduleName);
+            if (fromDisk == m_FromDisk.end())
+                continue;
+
+            // Each waiting thread uses its own copy of the shared_future
+            std::shared_future<void> scan = fromDisk->second;
+            scan.wait();
+        }
+
+        std::vector<std::future<void>> jobs;
+        for (auto &[moduleName, module] : modules)
+        {
+            module.moduleName = moduleName;
+            module.module = &m_Modules.at(moduleName);
+            jobs.push_back(m_Pool.Submit([this, &module] { CheckModule(module); }));
+        }
+        for (std::future<void> &job : jobs)
+            job.get();
+        jobs.clear();
+
+        for (auto &[moduleName, module] : modules)
+        {
+            for (size_t kind = 0; kind < std::size(module.passes); ++kind)
+            {
+                ScanPass &pass = module.passes[kind];
+                PlanChunks(pass, module.module->regions[kind], m_Pool.ThreadCount());
+                for (ScanChunk &chunk : pass.chunks)
+                    jobs.push_back(m_Pool.Submit([&pass, &chunk] { RunChunk(pass, chunk); }));
+            }
         }
+        for (std::future<void> &job : jobs)
+            job.get();
+
+        std::vector<std::string> errors;
+        {
+            std::lock_guard<std::mutex> lock(m_CacheMutex);
+            for (auto &[moduleName, module] : modules)
+                MergeModule(module, errors);
+
+            if (m_Cache.m_Dirty)
+            {
+                if (!m_Cache.Save(CachePath))
+                    std::cout << "Failed to write " << CachePath << "\n";
+                m_Cache.m_Dirty = false;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_StateMutex);
+            for (auto &[moduleName, module] : modules)
+            {
+                for (ResolvedOffset *offset : module.offsets)
+                    offset->m_State.store(module.loaded ? ResolvedOffset::Resolved : ResolvedOffset::Unresolved, std::memory_order_release);
+            }
+        }
+        m_StateChanged.notify_all();
+
+        // Shallowest first, so a base that's in this batch too is always done before it's needed
+        std::stable_sort(derived.begin(), derived.end(), [](ResolvedOffset *a, ResolvedOffset *b) { return Depth(*a->info) < Depth(*b->info); });
+        for (ResolvedOffset *offset : derived)
+        {
+            bool resolved = ResolveDerived(*offset, errors);
+            {
+                std::lock_guard<std::mutex> lock(m_StateMutex);
+                offset->m_State.store(resolved ? ResolvedOffset::Resolved : ResolvedOffset::Unresolved, std::memory_order_release);
+            }
+            m_StateChanged.notify_all();
+        }
+
+        ReportDuplicates(batch);
 
-        this->address = (uintptr_t)GetModuleHandle(moduleName.c_str()) + this->offset;
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        std::cout << "Resolved " << batch.size() << " offset(s) in " << elapsed.count() << " ms using " << m_Pool.ThreadCount() << " threads\n";
+
+        if (!errors.empty())
+        {
+            std::string msg = "Failed to resolve " + std::to_string(errors.size()) + " offset(s):\n";
+            for (const std::string &error : errors)
+                msg += "\n" + error;
+            Game::errorMsg(msg.c_str());
+        }
+    }
+
+    // Loads the module the first time one of its offsets is needed. A module that isn't loaded
+    // yet is tried again on the next call. Returns whether the module is loaded.
+    static bool PrepareModule(const std::string &moduleName, ModuleImage &module)
+    {
+        std::lock_guard<std::mutex> lock(module.mutex);
+        if (module.loaded)
+            return true;
+        if (!SigScanner::GetModuleImage(moduleName, module.bytes, module.size))
+            return false;
+
+        const bool isPE = module.image.Parse(module.bytes, module.size);
+        module.cacheable = isPE && ModuleIdentity::FromImage(moduleName, module.image, module.identity);
+
+        for (size_t kind = 0; kind < std::size(module.regions); ++kind)
+        {
+            if (isPE)
+                module.regions[kind] = module.image.Regions((SectionKind)kind);
+            else
+                module.regions[kind] = { { module.bytes, module.size, 0 } };
+        }
+        module.loaded = true;
+        return true;
+    }
+
+    // Takes each offset from the cache or the hardcoded value when it still matches its signature,
+    // everything else is left for a single multi-pattern pass over the sections it can be in.
+    void CheckModule(ModuleBatch &batch)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        ModuleImage &module = *batch.module;
+        batch.loaded = PrepareModule(batch.moduleName, module);
+        if (!batch.loaded)
+            return;
+
+        for (ResolvedOffset *offset : batch.offsets)
+        {
+            const Offset &info = *offset->info;
+            const Pattern &pattern = info.signature.pattern;
+            const std::vector<ImageRegion> &regions = module.regions[(size_t)info.sections];
+
+            int cached = -1;
+            if (module.cacheable)
+            {
+                std::lock_guard<std::mutex> lock(m_CacheMutex);
+                cached = m_Cache.Find(module.identity, OffsetCache::SignatureKey(info.signature.text, info.sigOffset));
+            }
+
+            if (cached >= 0 && SigScanner::CheckOffset(regions, cached, pattern, info.sigOffset))
+            {
+                batch.verified.emplace_back(offset, cached);
+                continue;
+            }
+
+            if (SigScanner::CheckOffset(regions, offset->m_Offset, pattern, info.sigOffset))
+            {
+                batch.verified.emplace_back(offset, offset->m_Offset);
+                continue;
+            }
+
+            ScanPass &pass = batch.passes[(size_t)info.sections];
+            pass.offsets.push_back(offset);
+            pass.patterns.push_back(&pattern);
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        batch.checkMs = elapsed.count();
+    }
+
+    // Splits every section a pass has to search into up to one chunk per thread
+    static void PlanChunks(ScanPass &pass, const std::vector<ImageRegion> &regions, size_t threadCount)
+    {
+        if (pass.patterns.empty())
+            return;
+
+        for (const ImageRegion &region : regions)
+        {
+            const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount, region.size / ScanChunkSize));
+            const size_t chunkSize = (region.size + chunkCount - 1) / chunkCount;
+
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+                pass.chunks.push_back({ region, chunk * chunkSize, (chunk + 1) * chunkSize });
+        }
+    }
+
+    static void RunChunk(const ScanPass &pass, ScanChunk &chunk)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        chunk.matches = SigScanner::FindPatterns(chunk.region.data, chunk.region.size, pass.patterns, chunk.begin, chunk.end);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        chunk.ms = elapsed.count();
+    }
+
+    // Chunk results are relative to their section, turns them into RVAs per pattern
+    static std::vector<PatternMatches> MergeChunks(ScanPass &pass, double &scanMs, size_t &bytesScanned)
+    {
+        std::vector<PatternMatches> matches(pass.patterns.size());
+        for (ScanChunk &chunk : pass.chunks)
+        {
+            for (size_t i = 0; i < chunk.matches.size(); ++i)
+            {
+                if (chunk.matches[i].count)
+                    chunk.matches[i].first += chunk.region.rva;
+                SigScanner::MergeMatches(matches[i], chunk.matches[i]);
+            }
+            scanMs += chunk.ms;
+            bytesScanned += std::min(chunk.end, chunk.region.size) - std::min(chunk.begin, chunk.region.size);
+        }
+        return matches;
+    }
+
+    // Runs on the resolving thread with the cache locked, in module order, so the cache and the
+    // console output come out the same regardless of which job finished first.
+    void MergeModule(ModuleBatch &batch, std::vector<std::string> &errors)
+    {
+        ModuleImage &module = *batch.module;
+        if (!batch.loaded)
+        {
+            // Not an error yet, its offsets stay Unresolved and are tried again on next use
+            std::cout << batch.moduleName << " isn't loaded yet, " << batch.offsets.size() << " offset(s) left unresolved\n";
+            return;
+        }
+
+        auto store = [&](ResolvedOffset *offset, int value)
+        {
+            const Offset &info = *offset->info;
+            offset->m_Offset = value;
+            if (module.cacheable)
+                m_Cache.Store(module.identity, OffsetCache::SignatureKey(info.signature.text, info.sigOffset), value);
+
+            int step = info.Follow(module.image, (uint32_t)value, offset->m_Rva);
+            if (step >= 0)
+            {
+                errors.push_back(batch.moduleName + ": " + info.name + " (step " + std::to_string(step + 1) + " leads out of the module)");
+                return;
+            }
+            offset->m_Address = (uintptr_t)module.bytes + offset->m_Rva;
+        };
+
+        for (auto &[offset, value] : batch.verified)
+            store(offset, value);
+
+        size_t scanned = 0, chunkCount = 0, bytesScanned = 0;
+        double scanMs = 0;
+
+        for (ScanPass &pass : batch.passes)
+        {
+            std::vector<PatternMatches> matches = MergeChunks(pass, scanMs, bytesScanned);
+
+            for (size_t i = 0; i < pass.offsets.size(); ++i)
+            {
+                ResolvedOffset *offset = pass.offsets[i];
+                const Offset &info = *offset->info;
+                if (matches[i].count == 0)
+                {
+                    errors.push_back(batch.moduleName + ": " + info.name + " (" + info.signature.text + ")");
+                    continue;
+                }
+
+                if (matches[i].count > 1)
+                    std::cout << "Signature of " << info.name << " matched " << matches[i].count << " times in " << batch.moduleName << ", using the first: " << info.signature.text << "\n";
+
+                store(offset, (int)matches[i].first + info.sigOffset);
+            }
+
+            scanned += pass.offsets.size();
+            chunkCount += pass.chunks.size();
+        }
+
+        std::cout << batch.moduleName << ": " << batch.offsets.size() << " offsets, " << scanned << " scanned in "
+            << chunkCount << " chunk(s) over " << bytesScanned / 1024 << " of " << module.size / 1024 << " KB, check "
+            << batch.checkMs << " ms, scan " << scanMs << " ms\n";
+    }
+
+    void ResolveFromDisk(const std::string &moduleName, const std::vector<const Offset *> &offsets)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        size_t found = ResolveModuleFromDisk(moduleName, offsets);
+
+        {
+            std::lock_guard<std::mutex> lock(m_CacheMutex);
+            if (m_Cache.m_Dirty)
+            {
+                if (!m_Cache.Save(CachePath))
+                    std::cout << "Failed to write " << CachePath << "\n";
+                m_Cache.m_Dirty = false;
+            }
+        }
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+        std::cout << "Pre-resolved " << found << " offset(s) of " << moduleName << " from disk in " << elapsed.count() << " ms\n";
+    }
+
+    // Returns how many offsets were stored. Offsets already cached for the build on disk are skipped,
+    // ambiguous ones are left to the regular scan, which reports them.
+    size_t ResolveModuleFromDisk(const std::string &moduleName, const std::vector<const Offset *> &offsets)
+    {
+        MappedFile file;
+        for (const char *dir : BinDirs)
+        {
+            if (file.Open(dir + moduleName))
+                break;
+        }
+
+        PEImage image;
+        ModuleIdentity identity;
+        if (!file.m_Data || !image.Parse(file.m_Data, file.m_Size, true) || !ModuleIdentity::FromImage(moduleName, image, identity))
+            return 0;
+
+        ScanPass passes[3];
+        std::vector<const Offset *> passOffsets[3];
+        {
+            std::lock_guard<std::mutex> lock(m_CacheMutex);
+            for (const Offset *offset : offsets)
+            {
+                if (m_Cache.Find(identity, OffsetCache::SignatureKey(offset->signature.text, offset->sigOffset)) >= 0)
+                    continue;
+
+                passes[(size_t)offset->sections].patterns.push_back(&offset->signature.pattern);
+                passOffsets[(size_t)offset->sections].push_back(offset);
+            }
+        }
+
+        std::vector<std::future<void>> jobs;
+        for (size_t kind = 0; kind < std::size(passes); ++kind)
+        {
+            ScanPass &pass = passes[kind];
+            PlanChunks(pass, image.Regions((SectionKind)kind), m_Pool.ThreadCount());
+            for (ScanChunk &chunk : pass.chunks)
+                jobs.push_back(m_Pool.Submit([&pass, &chunk] { RunChunk(pass, chunk); }));
+        }
+        for (std::future<void> &job : jobs)
+            job.get();
+
+        size_t stored = 0, bytesScanned = 0;
+        double scanMs = 0;
+        std::lock_guard<std::mutex> lock(m_CacheMutex);
+        for (size_t kind = 0; kind < std::size(passes); ++kind)
+        {
+            std::vector<PatternMatches> matches = MergeChunks(passes[kind], scanMs, bytesScanned);
+            for (size_t i = 0; i < matches.size(); ++i)
+            {
+                const Offset *offset = passOffsets[kind][i];
+                if (matches[i].count != 1)
+                    continue;
+
+                m_Cache.Store(identity, OffsetCache::SignatureKey(offset->signature.text, offset->sigOffset), (int)matches[i].first + offset->sigOffset);
+                ++stored;
+            }
+        }
+        return stored;
+    }
+
+    // Offsets reached from another offset take a few reads once their base is known, no scan.
+    // Returns false if the base's module isn't loaded yet, the offset is then tried again later.
+    bool ResolveDerived(ResolvedOffset &offset, std::vector<std::string> &errors)
+    {
+        const Offset &info = *offset.info;
+        ResolvedOffset &base = m_Resolved[IndexOf(*info.base)];
+        int baseAddress = base.Address();
+        if (!base.IsResolved())
+            return false;
+        if (!baseAddress)
+        {
+            errors.push_back(std::string(info.moduleName) + ": " + info.name + " (" + info.base->name + " wasn't found)");
+            return true;
+        }
+
+        // The base being resolved means its module is prepared
+        const ModuleImage &module = m_Modules.at(info.moduleName);
+        int step = info.Follow(module.image, base.m_Rva, offset.m_Rva);
+        if (step >= 0)
+        {
+            errors.push_back(std::string(info.moduleName) + ": " + info.name + " (step " + std::to_string(step + 1) + " leads out of the module)");
+            return true;
+        }
+
+        offset.m_Offset = (int)offset.m_Rva;
+        offset.m_Address = (uintptr_t)module.bytes + offset.m_Rva;
+        return true;
+    }
+
+    // Compares the batch against everything resolved so far, each pair is reported once
+    void ReportDuplicates(const std::vector<ResolvedOffset *> &batch)
+    {
+        for (ResolvedOffset *offset : batch)
+        {
+            for (const ResolvedOffset &other : m_Resolved)
+            {
+                if (&other == offset || !other.IsResolved() || other.m_Address != offset->m_Address || !offset->m_Address)
+                    continue;
+
+                // Pairs inside the batch are seen from both sides, only report them from the later one
+                if (&other > offset && std::find(batch.begin(), batch.end(), &other) != batch.end())
+                    continue;
+
+                std::cout << other.info->name << " and " << offset->info->name << " resolve to the same address in " << offset->info->moduleName << "\n";
+            }
+        }
     }
 };
 
-class Offsets
+inline int ResolvedOffset::Address()
 {
-public:
-    Offset GetFullScreenTexture =        { "client.dll", 0x1A83F0, "A1 ? ? ? ? 85 C0 75 53 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? 6A 00 6A 01 68 ? ? ? ? 68 ? ? ? ? FF D2 50 B9 ? ? ? ? E8 ? ? ? ? 80 3D ? ? ? ? ? 75 1C 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? 68 ? ? ? ? C6 05 ? ? ? ? ? FF D2 A1 ? ? ? ? C3" };
-    Offset RenderView =                  { "client.dll", 0x1F2120, "55 8B EC 83 EC 2C 53 56 8B F1 6A 00 8D 8E ? ? ? ? E8 ? ? ? ?" };
-    Offset g_pClientMode =               { "client.dll", 0x28A600, "8B 0D ? ? ? ? 8B", 2 };
-    Offset CalcViewModelView =           { "client.dll", 0x27D750, "55 8B EC 83 EC 34 53 8B D9 80 BB" };
-    Offset CreateMove =                  { "client.dll", 0x27A440, "55 8B EC A1 ? ? ? ? 83 EC 0C 83 78 30 00 56 8B 75 0C 57 8B F9 74 43" };
-
-    //Offset WriteUsercmdDeltaToBuffer =   { "client.dll", 0x134790, "55 8B EC 83 EC 60 0F 57 C0 8B 55 0C" }; //
-    Offset WriteUsercmd =                { "client.dll", 0x1C2060, "55 8B EC A1 ? ? ? ? 83 78 30 00 53 8B 5D 0C 56 57" };
-    Offset g_pppInput =                  { "client.dll", 0xD12A0, "8B 0D ? ? ? ? 8B 01 8B 50 68 FF E2", 2 };
-    /*Offset AdjustEngineViewport =        { "client.dll", 0x41AD10, "55 8B EC 8B 0D ? ? ? ? 85 C9 74 17" };
-    Offset IsSplitScreen =               { "client.dll", 0x1B2A60, "33 C0 83 3D ? ? ? ? ? 0F 9D C0" };*/
-    Offset PrePushRenderTarget =         { "client.dll", 0xA8C80, "55 8B EC 8B C1 56 8B 75 08 8B 0E 89 08 8B 56 04 89" };
-
-    Offset ReadUserCmd =                 { "server.dll", 0x205100, "55 8B EC 53 8B 5D 10 56 57 8B 7D 0C 53" };
-    Offset ProcessUsercmds =             { "server.dll", 0x170300, "55 8B EC B8 ? ? ? ? E8 ? ? ? ? 0F 57 C0 53 56 57 B9 ? ? ? ? 8D 85 ? ? ? ? 33 DB" }; //?
-    Offset CBaseEntity_entindex =        { "server.dll", 0x39F00, "8B 41 1C 85 C0 75 01 C3 8B 0D ? ? ? ? 2B 41 58 C1 F8 04 C3 CC"};
-    Offset EyePosition =                 { "server.dll", 0xF40E0, "55 8B EC 56 8B F1 8B 86 ? ? ? ? C1 E8 0B A8 01 74 05 E8 ? ? ? ? 8B 45 08 F3" };
-
-    /*Offset GetRenderTarget =             { "materialsystem.dll", 0x2CD30, "83 79 4C 00" };
-    Offset Viewport =                    { "materialsystem.dll", 0x2E010, "55 8B EC 8B 45 0C 53 8B 5D" };
-    Offset GetViewport =                 { "materialsystem.dll", 0x2CAF0, "55 8B EC 8B 41 4C 8B 49 40 8D 04 C0 83 7C 81 ? ?" };*/
-    Offset PushRenderTargetAndViewport = { "materialsystem.dll", 0x2D5F0, "55 8B EC 83 EC 24 8B 45 08 8B 55 10 89" };
-    Offset PopRenderTargetAndViewport =  { "materialsystem.dll", 0x2CE80, "56 8B F1 83 7E 4C 00" };
-
-    //Offset TraceFirePortalClient =       { "client.dll", 0x3E0980, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F1 6A" };
-    // Firing Portals
-    Offset TraceFirePortalServer =       { "server.dll", 0x400D50, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F1 6A" };
-    Offset CWeaponPortalgun_FirePortal = { "server.dll", 0x401370, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F9 89 7D EC E8 ? ? ? ?" };
-
-    //53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F1 6A 00 56 8D 4D C0 89 75 F8 E8
-    //Offset DrawModelExecute =            { "engine.dll", 0xE05E0, "55 8B EC 81 EC ? ? ? ? A1 ? ? ? ? 33 C5 89 45 FC 8B 45 10 56 8B 75 08 57 8B" }; //
-    Offset VGui_Paint =                  { "engine.dll", 0x115CE0, "55 8B EC E8 ? ? ? ? 8B 10 8B C8 8B 52 38" };
-
-    Offset PlayerPortalled = { "client.dll", 0x27C9D0, "55 8B EC 83 EC 78 53 56 8B D9 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? 57 33 FF 57 FF D2" };
-
-    // Ingame UI
-    Offset DrawSelf = { "client.dll", 0x12CC90, "55 8B EC 56 8B F1 80 BE ? ? ? ? ? 0F 84 ? ? ? ? 8B 0D" };
-    Offset ClipTransform = { "client.dll", 0x1DD130, "55 8B EC 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? FF D2 8B 4D" };
-    /*Offset VGui_GetHudBounds = { "client.dll", 0x1CC550, "55 8B EC 51 56 8B 75 08 8B CE" };
-    Offset VGui_GetPanelBounds = { "client.dll", 0x1CC350, "55 8B EC 8B 45 08 8B C8 83 E1 1F BA ? ? ? ?" };
-
-    Offset VGUI_UpdateScreenSpaceBounds = { "client.dll", 0x1CC8C0, "55 8B EC 83 EC 14 8B 45 0C 8B 4D 10 53 8B 5D 18 56 A3 ? ? ? ? 33 C0" };
-    Offset VGui_GetTrueScreenSize = { "client.dll", 0x1CBCF0, "55 8B EC 8B 45 08 8B 0D ? ? ? ? 8B 55 0C 89 08 A1 ? ? ? ? 89 02 5D C3" };*/
-
-    Offset VGui_GetClientDLLRootPanel = { "client.dll", 0x26EDF0, "8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? FF D2 8B 04 85 ? ? ? ? 8B 48 04" };
-    Offset g_pFullscreenRootPanel = { "client.dll", 0x26EE20, "A1 ? ? ? ? C3", 2 };
-
-    // Pointer laser
-    Offset CreatePingPointer = { "client.dll", 0x280660, "55 8B EC 83 EC 14 53 56 8B F1 8B 8E ? ? ? ? 57 85 C9 74 30" };
-    //Offset ClientThink = { "client.dll", 0x27EA30, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ?" };
-    Offset GetPortalPlayer = { "client.dll", 0x8DCA0, "55 8B EC 8B 45 08 83 F8 FF 75 10 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? FF D2" };
-    Offset PrecacheParticleSystem = { "server.dll", 0x16DF40, "55 8B EC 8B 0D ? ? ? ? 8B 55 08 8B 01 8B 40 20 6A 00 6A FF" };
-    Offset Precache = { "server.dll", 0x35A2C0, "E8 ? ? ? ? 68 ? ? ? ? E8 ? ? ? ?" };
-    //Offset GetActivePortalWeapon = { "client.dll", 0x2A8910, "8B 89 ? ? ? ? 83 F9 FF 74 1F 8B 15 ? ? ? ?" };
-
-    Offset SetControlPoint = { "client.dll", 0x17BD30, "55 8B EC 53 56 8B 75 0C 57 8B F9 BB ? ? ? ? 84 9F ? ? ? ?" };
-    Offset SetDrawOnlyForSplitScreenUser = { "client.dll", 0x17B9E0, "55 8B EC 8B 45 08 53 8B D9 3B 83 ? ? ? ? 74 55" };
-    Offset StopEmission = { "client.dll", 0x17B6A0, "55 8B EC 53 8B 5D 08 57 8B F9 F6 87 ? ? ? ? ? 74 7F" };
-
-    // Aim related
-    Offset CHudCrosshair_ShouldDraw = { "client.dll", 0x141BE0, "57 8B F9 80 BF ? ? ? ? ? 74 04 32 C0 5F C3" };
-
-    // VR Eyes
-    Offset UTIL_Portal_FirstAlongRay = { "server.dll", 0x377200, "55 8B EC 8B 0D ? ? ? ? 85 C9 74 19 A1 ? ? ? ?" };
-    Offset UTIL_IntersectRayWithPortal = { "server.dll", 0x376730, "55 8B EC 83 EC 48 56 8B 75 0C 85 F6 0F 84 ? ? ? ?" };
-    Offset UTIL_Portal_AngleTransform = { "server.dll", 0x375CA0, "55 8B EC 8B 45 08 8B 4D 0C 83 EC 0C 50 51 8D 55 F4" };
-
-    /*Offset GetScreenSize = { "vguimatsurface.dll", 0xB8C0, "55 8B EC 83 EC 08 80 B9 ? ? ? ? ? 74 1C" };
-    Offset GetHudSize = { "client.dll", 0x1CBCD0, "55 8B EC 8B 55 0C 8B 0D ? ? ? ? 8B 01 8B 80 ? ? ? ? 52 8B 55 08 52 FF D0 5D C3" };
-
-    Offset SetSizeC = { "client.dll", 0x63FB70, "55 8B EC 8B 41 04 8B 50 04 8B 45 0C 56 8B 35 ? ? ? ?" };
-    Offset SetSizeE = { "engine.dll", 0x298620, "55 8B EC 8B 41 04 8B 50 04 8B 45 0C 56 8B 35 ? ? ? ?" };
-    Offset SetSizeV = { "vguimatsurface.dll", 0x4B6D0, "55 8B EC 8B 41 04 8B 50 04 8B 45 0C 56 8B 35 ? ? ? ?" };
-
-    //Offset SetBoundsC = { "client.dll", 0x63FBF0, "55 8B EC 8B 55 0C 53 56 8B F1 8B 46 04 8B 48 04 8B 45 08 57 8B 3D ? ? ? ?" };
-    Offset SetBoundsE = { "engine.dll", 0x2986A0, "55 8B EC 8B 55 0C 53 56 8B F1 8B 46 04 8B 48 04 8B 45 08 57 8B 3D ? ? ? ? 8B 1F 8D 4C 31 04 52 8B 11 50 8B 02 FF D0 8B 53 08 50 8B CF FF D2" };*/
-   
-
-    /*Offset Push2DView = { "engine.dll", 0xDF980, "55 8B EC 51 53 8B D9 8B 83 ? ? ? ? 56 8D B3 ? ? ? ? 57 89 5D FC 3B 46 04 7C 09" };
-    Offset Render = { "client.dll", 0x1D6800, "55 8B EC 81 EC ? ? ? ? 53 56 57 8B F9 8B 0D ? ? ? ? 89 7D F4 FF 15 ? ? ? ?" };
-    Offset GetClipRect = { "vguimatsurface.dll", 0x4C700, "55 8B EC 8B 81 ? ? ? ? 8B 50 04 8B 45 14 56 8B 35 ? ? ? ? 57 8B 3E 8D 8C 0A ? ? ? ? 8B 55 10 50" };
-    //Offset GetWeaponCrosshairScale = {}
-    Offset GetModeHeight = { "engine.dll", 0x1F9F10, "8B 81 ? ? ? ? C3" };*/
-
-    //Grababbles
-    //Offset Weapon_ShootPosition =        { "client.dll", 0x2A8A60, "55 8B EC 8B 01 8B 90 ? ? ? ? 56 8B 75 08 56 FF D2 8B C6 5E 5D C2 04 00" };
-    Offset Weapon_ShootPosition = { "server.dll", 0x1033C0, "55 8B EC 8B 01 8B 90 ? ? ? ? 56 8B 75 08 56 FF D2 8B C6 5E 5D C2 04 00" };
-    Offset ComputeError = { "server.dll", 0x3C8140, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 8B F1 8B 86 ? ? ? ? 57 83 F8 FF 74 2A" };
-    Offset UpdateObject = { "server.dll", 0x3CA010, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F9 8B 87 ? ? ? ? 89 BD" };
-    Offset UpdateObjectVM = { "server.dll", 0x3CBB10, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F9 8B 87 ? ? ? ? 83 F8" };
-    Offset RotateObject = { "server.dll", 0x3C7890, "55 8B EC 0F 57 C0 F3 0F 10 4D ? 81 EC ? ? ? ? 0F 2E C8 9F 57 8B F9 F6 C4 44 7A 12" };
-    Offset EyeAngles = { "server.dll", 0x103A50, "55 8B EC 8B 81 ? ? ? ? 83 EC 60 56 57 8B 3D ? ? ? ? 83 F8 FF 74 1D" };
-
-    // For Portal gun VFX (do we really need all three??)
-    Offset MatrixBuildPerspectiveX = { "engine.dll", 0x2737E0, "55 8B EC 83 EC 08 F2 0F 10 45 ? F2 0F 59 05 ? ? ? ?" };
-    Offset GetFOV = { "client.dll", 0x2772B0, "55 8B EC 51 56 8B F1 E8 ? ? ? ? D9 5D FC 8B 06 8B 90 ? ? ? ? 8B CE FF D2" };
-    Offset GetDefaultFOV = { "client.dll", 0x279020, "A1 ? ? ? ? F3 0F 2C 40 ? C3" };
-    Offset GetViewModelFOV = { "client.dll", 0x28AB80, "A1 ? ? ? ? D9 40 2C C3" };
-
-    // Multiplayer
-    Offset GetOwner = { "server.dll", 0xD7550, "8B 81 ? ? ? ? 83 F8 FF 74 23 8B 15 ? ? ? ?" };
-    //Offset GetActiveWeapon = { "server.dll", 0xD3FD0, "8B 89 ? ? ? ? 83 F9 FF 74 1F 8B 15 ? ? ? ?" };
-};
\ No newline at end of file
+    if (!IsResolved())
+        m_Owner->Resolve(*this);
+    return m_Address;
+}
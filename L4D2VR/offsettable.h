@@ -0,0 +1,231 @@
+#pragma once
+#include <iterator>
+#include "sigscanner.h"
+
+// Kept free of Windows and game headers so the offline tools in tools/ can use the table too.
+
+// One step from where a signature matched towards the address that's actually wanted
+struct ResolveStep
+{
+    enum Kind
+    {
+        Rel32,  // follow the rel32 operand at the address, as in E8/E9 rel32
+        Deref,  // read the absolute address stored at the address, as in 8B 0D [abs32]
+        Add,    // add value
+        VTable  // read entry value of the vtable at the address
+    };
+
+    Kind kind;
+    int value;
+};
+
+// Where a function or global was found in a known game build and the signature that finds it
+// again after an update. Signatures are parsed at compile time, a malformed one fails the build.
+struct Offset
+{
+    static constexpr int MaxSteps = 4;
+
+    const char *name;
+    const char *moduleName;
+    int offset;
+    Signature signature;
+    int sigOffset = 0;
+    // Code signatures, including the ones that read a global's address out of an instruction
+    // through sigOffset, only need the executable sections. Data is for matching tables or
+    // strings in .rdata/.data.
+    SectionKind sections = SectionKind::Code;
+
+    // Set for offsets reached from another one instead of scanning for their own signature
+    const Offset *base = nullptr;
+    ResolveStep steps[MaxSteps] = {};
+    int stepCount = 0;
+
+    // Starts a chain at another offset of the same module: Offset::From("Foo", Bar).Add(0x1F).Rel32()
+    static constexpr Offset From(const char *name, const Offset &base)
+    {
+        Offset offset = { name, base.moduleName, 0, {} };
+        offset.base = &base;
+        return offset;
+    }
+
+    constexpr Offset Rel32() const { return Then(ResolveStep::Rel32, 0); }
+    constexpr Offset Deref() const { return Then(ResolveStep::Deref, 0); }
+    constexpr Offset Add(int displacement) const { return Then(ResolveStep::Add, displacement); }
+    constexpr Offset VTable(int index) const { return Then(ResolveStep::VTable, index); }
+
+    constexpr Offset Then(ResolveStep::Kind kind, int value) const
+    {
+        if (stepCount == MaxSteps)
+            throw std::length_error("Offset has more than MaxSteps resolve steps");
+
+        Offset offset = *this;
+        offset.steps[offset.stepCount++] = { kind, value };
+        return offset;
+    }
+
+    // Runs the steps from rva, the steps only read static data of the image so the result can be
+    // worked out from a loaded module and a DLL on disk alike. Returns the index of the step that
+    // led out of the image, or -1.
+    int Follow(const PEImage &image, uint32_t rva, uint32_t &out) const
+    {
+        for (int i = 0; i < stepCount; ++i)
+        {
+            const ResolveStep &step = steps[i];
+            int32_t rel;
+            switch (step.kind)
+            {
+            case ResolveStep::Rel32:
+                if (!image.ReadRva(rva, rel))
+                    return i;
+                rva += 4 + rel;
+                break;
+            case ResolveStep::Deref:
+                if (!image.ReadPointerRva(rva, rva))
+                    return i;
+                break;
+            case ResolveStep::Add:
+                rva += step.value;
+                break;
+            case ResolveStep::VTable:
+                if (!image.ReadPointerRva(rva + step.value * (uint32_t)image.PointerSize(), rva))
+                    return i;
+                break;
+            }
+
+            if (rva >= image.m_SizeOfImage)
+                return i;
+        }
+
+        out = rva;
+        return -1;
+    }
+};
+
+struct OffsetTable
+{
+    static constexpr Offset GetFullScreenTexture =        { "GetFullScreenTexture", "client.dll", 0x1A83F0, "A1 ? ? ? ? 85 C0 75 53 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? 6A 00 6A 01 68 ? ? ? ? 68 ? ? ? ? FF D2 50 B9 ? ? ? ? E8 ? ? ? ? 80 3D ? ? ? ? ? 75 1C 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? 68 ? ? ? ? C6 05 ? ? ? ? ? FF D2 A1 ? ? ? ? C3"_sig };
+    static constexpr Offset RenderView =                  { "RenderView", "client.dll", 0x1F2120, "55 8B EC 83 EC 2C 53 56 8B F1 6A 00 8D 8E ? ? ? ? E8 ? ? ? ?"_sig };
+    static constexpr Offset g_pClientMode =               Offset{ "g_pClientMode", "client.dll", 0x28A600, "8B 0D ? ? ? ? 8B"_sig, 2 }.Deref();
+    static constexpr Offset CalcViewModelView =           { "CalcViewModelView", "client.dll", 0x27D750, "55 8B EC 83 EC 34 53 8B D9 80 BB"_sig };
+    static constexpr Offset CreateMove =                  { "CreateMove", "client.dll", 0x27A440, "55 8B EC A1 ? ? ? ? 83 EC 0C 83 78 30 00 56 8B 75 0C 57 8B F9 74 43"_sig };
+
+    //static constexpr Offset WriteUsercmdDeltaToBuffer =   { "WriteUsercmdDeltaToBuffer", "client.dll", 0x134790, "55 8B EC 83 EC 60 0F 57 C0 8B 55 0C"_sig }; //
+    static constexpr Offset WriteUsercmd =                { "WriteUsercmd", "client.dll", 0x1C2060, "55 8B EC A1 ? ? ? ? 83 78 30 00 53 8B 5D 0C 56 57"_sig };
+    static constexpr Offset g_pppInput =                  Offset{ "g_pppInput", "client.dll", 0xD12A0, "8B 0D ? ? ? ? 8B 01 8B 50 68 FF E2"_sig, 2 }.Deref();
+    /*static constexpr Offset AdjustEngineViewport =        { "AdjustEngineViewport", "client.dll", 0x41AD10, "55 8B EC 8B 0D ? ? ? ? 85 C9 74 17"_sig };
+    static constexpr Offset IsSplitScreen =               { "IsSplitScreen", "client.dll", 0x1B2A60, "33 C0 83 3D ? ? ? ? ? 0F 9D C0"_sig };*/
+    static constexpr Offset PrePushRenderTarget =         { "PrePushRenderTarget", "client.dll", 0xA8C80, "55 8B EC 8B C1 56 8B 75 08 8B 0E 89 08 8B 56 04 89"_sig };
+
+    static constexpr Offset ReadUserCmd =                 { "ReadUserCmd", "server.dll", 0x205100, "55 8B EC 53 8B 5D 10 56 57 8B 7D 0C 53"_sig };
+    static constexpr Offset ProcessUsercmds =             { "ProcessUsercmds", "server.dll", 0x170300, "55 8B EC B8 ? ? ? ? E8 ? ? ? ? 0F 57 C0 53 56 57 B9 ? ? ? ? 8D 85 ? ? ? ? 33 DB"_sig }; //?
+    static constexpr Offset CBaseEntity_entindex =        { "CBaseEntity_entindex", "server.dll", 0x39F00, "8B 41 1C 85 C0 75 01 C3 8B 0D ? ? ? ? 2B 41 58 C1 F8 04 C3 CC"_sig};
+    static constexpr Offset EyePosition =                 { "EyePosition", "server.dll", 0xF40E0, "55 8B EC 56 8B F1 8B 86 ? ? ? ? C1 E8 0B A8 01 74 05 E8 ? ? ? ? 8B 45 08 F3"_sig };
+
+    /*static constexpr Offset GetRenderTarget =             { "GetRenderTarget", "materialsystem.dll", 0x2CD30, "83 79 4C 00"_sig };
+    static constexpr Offset Viewport =                    { "Viewport", "materialsystem.dll", 0x2E010, "55 8B EC 8B 45 0C 53 8B 5D"_sig };
+    static constexpr Offset GetViewport =                 { "GetViewport", "materialsystem.dll", 0x2CAF0, "55 8B EC 8B 41 4C 8B 49 40 8D 04 C0 83 7C 81 ? ?"_sig };*/
+    static constexpr Offset PushRenderTargetAndViewport = { "PushRenderTargetAndViewport", "materialsystem.dll", 0x2D5F0, "55 8B EC 83 EC 24 8B 45 08 8B 55 10 89"_sig };
+    static constexpr Offset PopRenderTargetAndViewport =  { "PopRenderTargetAndViewport", "materialsystem.dll", 0x2CE80, "56 8B F1 83 7E 4C 00"_sig };
+
+    //static constexpr Offset TraceFirePortalClient =       { "TraceFirePortalClient", "client.dll", 0x3E0980, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F1 6A"_sig };
+    // Firing Portals
+    static constexpr Offset TraceFirePortalServer =       { "TraceFirePortalServer", "server.dll", 0x400D50, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F1 6A"_sig };
+    static constexpr Offset CWeaponPortalgun_FirePortal = { "CWeaponPortalgun_FirePortal", "server.dll", 0x401370, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F9 89 7D EC E8 ? ? ? ?"_sig };
+
+    //53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F1 6A 00 56 8D 4D C0 89 75 F8 E8
+    //static constexpr Offset DrawModelExecute =            { "DrawModelExecute", "engine.dll", 0xE05E0, "55 8B EC 81 EC ? ? ? ? A1 ? ? ? ? 33 C5 89 45 FC 8B 45 10 56 8B 75 08 57 8B"_sig }; //
+    static constexpr Offset VGui_Paint =                  { "VGui_Paint", "engine.dll", 0x115CE0, "55 8B EC E8 ? ? ? ? 8B 10 8B C8 8B 52 38"_sig };
+
+    static constexpr Offset PlayerPortalled = { "PlayerPortalled", "client.dll", 0x27C9D0, "55 8B EC 83 EC 78 53 56 8B D9 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? 57 33 FF 57 FF D2"_sig };
+
+    // Ingame UI
+    static constexpr Offset DrawSelf = { "DrawSelf", "client.dll", 0x12CC90, "55 8B EC 56 8B F1 80 BE ? ? ? ? ? 0F 84 ? ? ? ? 8B 0D"_sig };
+    static constexpr Offset ClipTransform = { "ClipTransform", "client.dll", 0x1DD130, "55 8B EC 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? FF D2 8B 4D"_sig };
+    /*static constexpr Offset VGui_GetHudBounds = { "VGui_GetHudBounds", "client.dll", 0x1CC550, "55 8B EC 51 56 8B 75 08 8B CE"_sig };
+    static constexpr Offset VGui_GetPanelBounds = { "VGui_GetPanelBounds", "client.dll", 0x1CC350, "55 8B EC 8B 45 08 8B C8 83 E1 1F BA ? ? ? ?"_sig };
+
+    static constexpr Offset VGUI_UpdateScreenSpaceBounds = { "VGUI_UpdateScreenSpaceBounds", "client.dll", 0x1CC8C0, "55 8B EC 83 EC 14 8B 45 0C 8B 4D 10 53 8B 5D 18 56 A3 ? ? ? ? 33 C0"_sig };
+    static constexpr Offset VGui_GetTrueScreenSize = { "VGui_GetTrueScreenSize", "client.dll", 0x1CBCF0, "55 8B EC 8B 45 08 8B 0D ? ? ? ? 8B 55 0C 89 08 A1 ? ? ? ? 89 02 5D C3"_sig };*/
+
+    static constexpr Offset VGui_GetClientDLLRootPanel = { "VGui_GetClientDLLRootPanel", "client.dll", 0x26EDF0, "8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? FF D2 8B 04 85 ? ? ? ? 8B 48 04"_sig };
+    static constexpr Offset g_pFullscreenRootPanel = { "g_pFullscreenRootPanel", "client.dll", 0x26EE20, "A1 ? ? ? ? C3"_sig, 2 };
+
+    // Pointer laser
+    static constexpr Offset CreatePingPointer = { "CreatePingPointer", "client.dll", 0x280660, "55 8B EC 83 EC 14 53 56 8B F1 8B 8E ? ? ? ? 57 85 C9 74 30"_sig };
+    //static constexpr Offset ClientThink = { "ClientThink", "client.dll", 0x27EA30, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ?"_sig };
+    static constexpr Offset GetPortalPlayer = { "GetPortalPlayer", "client.dll", 0x8DCA0, "55 8B EC 8B 45 08 83 F8 FF 75 10 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? FF D2"_sig };
+    static constexpr Offset PrecacheParticleSystem = { "PrecacheParticleSystem", "server.dll", 0x16DF40, "55 8B EC 8B 0D ? ? ? ? 8B 55 08 8B 01 8B 40 20 6A 00 6A FF"_sig };
+    static constexpr Offset Precache = { "Precache", "server.dll", 0x35A2C0, "E8 ? ? ? ? 68 ? ? ? ? E8 ? ? ? ?"_sig };
+    //static constexpr Offset GetActivePortalWeapon = { "GetActivePortalWeapon", "client.dll", 0x2A8910, "8B 89 ? ? ? ? 83 F9 FF 74 1F 8B 15 ? ? ? ?"_sig };
+
+    static constexpr Offset SetControlPoint = { "SetControlPoint", "client.dll", 0x17BD30, "55 8B EC 53 56 8B 75 0C 57 8B F9 BB ? ? ? ? 84 9F ? ? ? ?"_sig };
+    static constexpr Offset SetDrawOnlyForSplitScreenUser = { "SetDrawOnlyForSplitScreenUser", "client.dll", 0x17B9E0, "55 8B EC 8B 45 08 53 8B D9 3B 83 ? ? ? ? 74 55"_sig };
+    static constexpr Offset StopEmission = { "StopEmission", "client.dll", 0x17B6A0, "55 8B EC 53 8B 5D 08 57 8B F9 F6 87 ? ? ? ? ? 74 7F"_sig };
+
+    // Aim related
+    static constexpr Offset CHudCrosshair_ShouldDraw = { "CHudCrosshair_ShouldDraw", "client.dll", 0x141BE0, "57 8B F9 80 BF ? ? ? ? ? 74 04 32 C0 5F C3"_sig };
+
+    // VR Eyes
+    static constexpr Offset UTIL_Portal_FirstAlongRay = { "UTIL_Portal_FirstAlongRay", "server.dll", 0x377200, "55 8B EC 8B 0D ? ? ? ? 85 C9 74 19 A1 ? ? ? ?"_sig };
+    static constexpr Offset UTIL_IntersectRayWithPortal = { "UTIL_IntersectRayWithPortal", "server.dll", 0x376730, "55 8B EC 83 EC 48 56 8B 75 0C 85 F6 0F 84 ? ? ? ?"_sig };
+    static constexpr Offset UTIL_Portal_AngleTransform = { "UTIL_Portal_AngleTransform", "server.dll", 0x375CA0, "55 8B EC 8B 45 08 8B 4D 0C 83 EC 0C 50 51 8D 55 F4"_sig };
+
+    /*static constexpr Offset GetScreenSize = { "GetScreenSize", "vguimatsurface.dll", 0xB8C0, "55 8B EC 83 EC 08 80 B9 ? ? ? ? ? 74 1C"_sig };
+    static constexpr Offset GetHudSize = { "GetHudSize", "client.dll", 0x1CBCD0, "55 8B EC 8B 55 0C 8B 0D ? ? ? ? 8B 01 8B 80 ? ? ? ? 52 8B 55 08 52 FF D0 5D C3"_sig };
+
+    static constexpr Offset SetSizeC = { "SetSizeC", "client.dll", 0x63FB70, "55 8B EC 8B 41 04 8B 50 04 8B 45 0C 56 8B 35 ? ? ? ?"_sig };
+    static constexpr Offset SetSizeE = { "SetSizeE", "engine.dll", 0x298620, "55 8B EC 8B 41 04 8B 50 04 8B 45 0C 56 8B 35 ? ? ? ?"_sig };
+    static constexpr Offset SetSizeV = { "SetSizeV", "vguimatsurface.dll", 0x4B6D0, "55 8B EC 8B 41 04 8B 50 04 8B 45 0C 56 8B 35 ? ? ? ?"_sig };
+
+    //static constexpr Offset SetBoundsC = { "SetBoundsC", "client.dll", 0x63FBF0, "55 8B EC 8B 55 0C 53 56 8B F1 8B 46 04 8B 48 04 8B 45 08 57 8B 3D ? ? ? ?"_sig };
+    static constexpr Offset SetBoundsE = { "SetBoundsE", "engine.dll", 0x2986A0, "55 8B EC 8B 55 0C 53 56 8B F1 8B 46 04 8B 48 04 8B 45 08 57 8B 3D ? ? ? ? 8B 1F 8D 4C 31 04 52 8B 11 50 8B 02 FF D0 8B 53 08 50 8B CF FF D2"_sig };*/
+   
+
+    /*static constexpr Offset Push2DView = { "Push2DView", "engine.dll", 0xDF980, "55 8B EC 51 53 8B D9 8B 83 ? ? ? ? 56 8D B3 ? ? ? ? 57 89 5D FC 3B 46 04 7C 09"_sig };
+    static constexpr Offset Render = { "Render", "client.dll", 0x1D6800, "55 8B EC 81 EC ? ? ? ? 53 56 57 8B F9 8B 0D ? ? ? ? 89 7D F4 FF 15 ? ? ? ?"_sig };
+    static constexpr Offset GetClipRect = { "GetClipRect", "vguimatsurface.dll", 0x4C700, "55 8B EC 8B 81 ? ? ? ? 8B 50 04 8B 45 14 56 8B 35 ? ? ? ? 57 8B 3E 8D 8C 0A ? ? ? ? 8B 55 10 50"_sig };
+    //Offset GetWeaponCrosshairScale = {}
+    static constexpr Offset GetModeHeight = { "GetModeHeight", "engine.dll", 0x1F9F10, "8B 81 ? ? ? ? C3"_sig };*/
+
+    //Grababbles
+    //static constexpr Offset Weapon_ShootPosition =        { "Weapon_ShootPosition", "client.dll", 0x2A8A60, "55 8B EC 8B 01 8B 90 ? ? ? ? 56 8B 75 08 56 FF D2 8B C6 5E 5D C2 04 00"_sig };
+    static constexpr Offset Weapon_ShootPosition = { "Weapon_ShootPosition", "server.dll", 0x1033C0, "55 8B EC 8B 01 8B 90 ? ? ? ? 56 8B 75 08 56 FF D2 8B C6 5E 5D C2 04 00"_sig };
+    static constexpr Offset ComputeError = { "ComputeError", "server.dll", 0x3C8140, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 8B F1 8B 86 ? ? ? ? 57 83 F8 FF 74 2A"_sig };
+    static constexpr Offset UpdateObject = { "UpdateObject", "server.dll", 0x3CA010, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F9 8B 87 ? ? ? ? 89 BD"_sig };
+    static constexpr Offset UpdateObjectVM = { "UpdateObjectVM", "server.dll", 0x3CBB10, "53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F9 8B 87 ? ? ? ? 83 F8"_sig };
+    static constexpr Offset RotateObject = { "RotateObject", "server.dll", 0x3C7890, "55 8B EC 0F 57 C0 F3 0F 10 4D ? 81 EC ? ? ? ? 0F 2E C8 9F 57 8B F9 F6 C4 44 7A 12"_sig };
+    static constexpr Offset EyeAngles = { "EyeAngles", "server.dll", 0x103A50, "55 8B EC 8B 81 ? ? ? ? 83 EC 60 56 57 8B 3D ? ? ? ? 83 F8 FF 74 1D"_sig };
+
+    // For Portal gun VFX (do we really need all three??)
+    static constexpr Offset MatrixBuildPerspectiveX = { "MatrixBuildPerspectiveX", "engine.dll", 0x2737E0, "55 8B EC 83 EC 08 F2 0F 10 45 ? F2 0F 59 05 ? ? ? ?"_sig };
+    static constexpr Offset GetFOV = { "GetFOV", "client.dll", 0x2772B0, "55 8B EC 51 56 8B F1 E8 ? ? ? ? D9 5D FC 8B 06 8B 90 ? ? ? ? 8B CE FF D2"_sig };
+    static constexpr Offset GetDefaultFOV = { "GetDefaultFOV", "client.dll", 0x279020, "A1 ? ? ? ? F3 0F 2C 40 ? C3"_sig };
+    static constexpr Offset GetViewModelFOV = { "GetViewModelFOV", "client.dll", 0x28AB80, "A1 ? ? ? ? D9 40 2C C3"_sig };
+
+    // Multiplayer
+    static constexpr Offset GetOwner = { "GetOwner", "server.dll", 0xD7550, "8B 81 ? ? ? ? 83 F8 FF 74 23 8B 15 ? ? ? ?"_sig };
+    //static constexpr Offset GetActiveWeapon = { "GetActiveWeapon", "server.dll", 0xD3FD0, "8B 89 ? ? ? ? 83 F9 FF 74 1F 8B 15 ? ? ? ?"_sig };
+
+    // Every offset Offsets knows about
+    static constexpr const Offset *All[] = {
+        &GetFullScreenTexture, &RenderView, &g_pClientMode, &CalcViewModelView, &CreateMove, &WriteUsercmd,
+        &g_pppInput, &PrePushRenderTarget, &ReadUserCmd, &ProcessUsercmds, &CBaseEntity_entindex, &EyePosition,
+        &PushRenderTargetAndViewport, &PopRenderTargetAndViewport, &TraceFirePortalServer,
+        &CWeaponPortalgun_FirePortal, &VGui_Paint, &PlayerPortalled, &DrawSelf, &ClipTransform,
+        &VGui_GetClientDLLRootPanel, &g_pFullscreenRootPanel, &CreatePingPointer, &GetPortalPlayer,
+        &PrecacheParticleSystem, &Precache, &SetControlPoint, &SetDrawOnlyForSplitScreenUser, &StopEmission,
+        &CHudCrosshair_ShouldDraw, &UTIL_Portal_FirstAlongRay, &UTIL_IntersectRayWithPortal,
+        &UTIL_Portal_AngleTransform, &Weapon_ShootPosition, &ComputeError, &UpdateObject, &UpdateObjectVM,
+        &RotateObject, &EyeAngles, &MatrixBuildPerspectiveX, &GetFOV, &GetDefaultFOV, &GetViewModelFOV, &GetOwner
+    };
+
+    // What the enabled single-player hooks need, warmed up while the rest of Game starts
+    static constexpr const Offset *Startup[] = {
+        &RenderView, &CalcViewModelView, &ProcessUsercmds, &ReadUserCmd, &WriteUsercmd, &CreateMove,
+        &EyePosition, &Weapon_ShootPosition, &TraceFirePortalServer, &CWeaponPortalgun_FirePortal, &DrawSelf,
+        &PlayerPortalled, &UTIL_Portal_FirstAlongRay, &UTIL_IntersectRayWithPortal, &UTIL_Portal_AngleTransform,
+        &UpdateObject, &UpdateObjectVM, &EyeAngles, &GetDefaultFOV, &GetFOV, &GetViewModelFOV, &GetPortalPlayer,
+        &CreatePingPointer, &PrecacheParticleSystem, &Precache, &SetDrawOnlyForSplitScreenUser,
+        &SetControlPoint, &StopEmission, &CHudCrosshair_ShouldDraw, &CBaseEntity_entindex, &GetOwner
+    };
+};
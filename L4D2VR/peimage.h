@@ -0,0 +1,243 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+// Minimal PE header reader that works on plain byte buffers, so it does not need Windows.h.
+// The buffer can be a module loaded by Windows (RVAs index straight into it) or a DLL file
+// read from disk (RVAs go through the section table).
+
+// Which sections a signature is searched in
+enum class SectionKind
+{
+	Code, // executable sections, what almost every signature matches
+	Data, // initialized, non-executable sections (.rdata, .data)
+	Any
+};
+
+// A contiguous piece of an image and the RVA it starts at
+struct ImageRegion
+{
+	const uint8_t *data;
+	size_t size;
+	uint32_t rva;
+};
+
+struct PESection
+{
+	char name[9];
+	uint32_t virtualAddress;
+	uint32_t virtualSize;
+	uint32_t rawOffset;
+	uint32_t rawSize;
+	uint32_t characteristics;
+
+	bool IsExecutable() const { return (characteristics & 0x20000000) != 0; } // IMAGE_SCN_MEM_EXECUTE
+	bool IsInitializedData() const { return (characteristics & 0x00000040) != 0; } // IMAGE_SCN_CNT_INITIALIZED_DATA
+
+	bool Matches(SectionKind kind) const
+	{
+		switch (kind)
+		{
+		case SectionKind::Code:
+			return IsExecutable();
+		case SectionKind::Data:
+			return !IsExecutable() && IsInitializedData();
+		default:
+			return true;
+		}
+	}
+};
+
+class PEImage
+{
+public:
+	const uint8_t *m_Bytes = nullptr;
+	size_t m_Size = 0;
+	bool m_FileLayout = false;
+
+	uint32_t m_TimeDateStamp = 0;
+	uint32_t m_SizeOfImage = 0;
+	uint64_t m_ImageBase = 0;
+	bool m_Is64 = false;
+	uint32_t m_SizeOfHeaders = 0;
+	uint32_t m_RelocRva = 0;
+	uint32_t m_RelocSize = 0;
+	std::vector<PESection> m_Sections;
+
+	template <typename T>
+	bool Read(size_t offset, T &out) const
+	{
+		if (offset + sizeof(T) > m_Size)
+			return false;
+		memcpy(&out, m_Bytes + offset, sizeof(T));
+		return true;
+	}
+
+	// Reads at an RVA, which only differs from a plain Read for images in file layout
+	template <typename T>
+	bool ReadRva(uint32_t rva, T &out) const
+	{
+		size_t offset = RvaToOffset(rva);
+		return offset != (size_t)-1 && Read(offset, out);
+	}
+
+	// fileLayout: the buffer holds the DLL as stored on disk rather than mapped by the loader
+	bool Parse(const uint8_t *bytes, size_t size, bool fileLayout = false)
+	{
+		m_Bytes = bytes;
+		m_Size = size;
+		m_FileLayout = fileLayout;
+		m_Sections.clear();
+
+		uint16_t mz;
+		uint32_t peOffset, peSig;
+		if (!Read(0, mz) || mz != 0x5A4D || !Read(0x3C, peOffset) || !Read(peOffset, peSig) || peSig != 0x00004550)
+			return false;
+
+		const size_t fileHeader = peOffset + 4;
+		const size_t optHeader = fileHeader + 20;
+		uint16_t numSections, optHeaderSize, magic;
+		if (!Read(fileHeader + 2, numSections) || !Read(fileHeader + 4, m_TimeDateStamp) ||
+			!Read(fileHeader + 16, optHeaderSize) || !Read(optHeader, magic) || !Read(optHeader + 56, m_SizeOfImage))
+			return false;
+
+		// Data directories start at a different offset for PE32 and PE32+, the base relocation table is entry 5
+		m_Is64 = magic == 0x20B;
+		const size_t dataDirs = optHeader + (m_Is64 ? 112 : 96);
+		if (!Read(optHeader + 60, m_SizeOfHeaders))
+			return false;
+
+		uint32_t imageBase32 = 0;
+		if (m_Is64)
+			Read(optHeader + 24, m_ImageBase);
+		else if (Read(optHeader + 28, imageBase32))
+			m_ImageBase = imageBase32;
+		Read(dataDirs + 5 * 8, m_RelocRva);
+		Read(dataDirs + 5 * 8 + 4, m_RelocSize);
+
+		size_t sectionHeader = optHeader + optHeaderSize;
+		for (int i = 0; i < numSections; ++i, sectionHeader += 40)
+		{
+			PESection section = {};
+			if (sectionHeader + 40 > m_Size)
+				return false;
+
+			memcpy(section.name, m_Bytes + sectionHeader, 8);
+			Read(sectionHeader + 8, section.virtualSize);
+			Read(sectionHeader + 12, section.virtualAddress);
+			Read(sectionHeader + 16, section.rawSize);
+			Read(sectionHeader + 20, section.rawOffset);
+			Read(sectionHeader + 36, section.characteristics);
+			m_Sections.push_back(section);
+		}
+		return true;
+	}
+
+	// Returns (size_t)-1 for RVAs that have no bytes in the buffer
+	size_t RvaToOffset(uint32_t rva) const
+	{
+		if (!m_FileLayout || rva < m_SizeOfHeaders)
+			return rva < m_Size ? rva : (size_t)-1;
+
+		for (const PESection &section : m_Sections)
+		{
+			if (rva >= section.virtualAddress && rva - section.virtualAddress < section.rawSize)
+			{
+				size_t offset = (size_t)section.rawOffset + (rva - section.virtualAddress);
+				return offset < m_Size ? offset : (size_t)-1;
+			}
+		}
+		return (size_t)-1;
+	}
+
+	// Reads an absolute pointer stored in the image and turns it back into an RVA. A loaded image
+	// holds pointers relocated to where it was loaded, a file the ones for its preferred base.
+	// Fails for pointers that lead out of the image.
+	bool ReadPointerRva(uint32_t rva, uint32_t &out) const
+	{
+		uint64_t value = 0;
+		uint32_t value32 = 0;
+		if (m_Is64 ? !ReadRva(rva, value) : !ReadRva(rva, value32))
+			return false;
+		if (!m_Is64)
+			value = value32;
+
+		const uint64_t base = m_FileLayout ? m_ImageBase : (uint64_t)(uintptr_t)m_Bytes;
+		if (value < base || value - base >= m_SizeOfImage)
+			return false;
+
+		out = (uint32_t)(value - base);
+		return true;
+	}
+
+	size_t PointerSize() const { return m_Is64 ? 8 : 4; }
+
+	// The bytes of a section that are present in the buffer. Uninitialized tails (.bss) and
+	// file alignment padding are left out, so both layouts give the same region.
+	ImageRegion SectionRegion(const PESection &section) const
+	{
+		size_t size = section.virtualSize ? section.virtualSize : section.rawSize;
+		if (m_FileLayout)
+			size = std::min<size_t>(size, section.rawSize);
+
+		size_t offset = m_FileLayout ? section.rawOffset : section.virtualAddress;
+		if (offset >= m_Size)
+			return { m_Bytes, 0, section.virtualAddress };
+
+		return { m_Bytes + offset, std::min(size, m_Size - offset), section.virtualAddress };
+	}
+
+	std::vector<ImageRegion> Regions(SectionKind kind) const
+	{
+		std::vector<ImageRegion> regions;
+		for (const PESection &section : m_Sections)
+		{
+			ImageRegion region = SectionRegion(section);
+			if (section.Matches(kind) && region.size)
+				regions.push_back(region);
+		}
+		return regions;
+	}
+
+	const PESection *FindSection(const char *name) const
+	{
+		for (const PESection &section : m_Sections)
+		{
+			if (strcmp(section.name, name) == 0)
+				return &section;
+		}
+		return nullptr;
+	}
+
+	// Calls f(rva, width) for every absolute address the loader patches when rebasing the image.
+	template <typename F>
+	void ForEachRelocation(F f) const
+	{
+		size_t block = m_RelocRva;
+		const size_t end = (size_t)m_RelocRva + m_RelocSize;
+
+		while (block + 8 <= end)
+		{
+			uint32_t pageRva, blockSize;
+			if (!ReadRva((uint32_t)block, pageRva) || !ReadRva((uint32_t)block + 4, blockSize) || blockSize < 8)
+				return;
+
+			for (size_t entry = block + 8; entry + 2 <= block + blockSize; entry += 2)
+			{
+				uint16_t value;
+				if (!ReadRva((uint32_t)entry, value))
+					return;
+
+				const int type = value >> 12;
+				if (type == 3) // IMAGE_REL_BASED_HIGHLOW
+					f(pageRva + (value & 0xFFF), 4);
+				else if (type == 10) // IMAGE_REL_BASED_DIR64
+					f(pageRva + (value & 0xFFF), 8);
+			}
+			block += blockSize;
+		}
+	}
+};
@@ -0,0 +1,330 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include "openvr.h"
+
+// Timestamped poses of the HMD and both hands, in tracking space, queried for any point in time.
+// Poses between two samples are interpolated, poses shortly after the newest one are extrapolated
+// from its velocities. One thread pushes without locks, any thread can read without waiting.
+namespace PoseHistory
+{
+	// Samples kept per device, at 90 Hz that's the last 0.7 seconds
+	constexpr uint64_t Capacity = 64;
+	// How far past the newest sample poses are extrapolated
+	constexpr float MaxExtrapolationSeconds = 0.05f;
+
+	enum Device
+	{
+		Hmd,
+		LeftHand,
+		RightHand,
+		DeviceCount
+	};
+
+	inline vr::HmdQuaternionf_t QuaternionFromMatrix(const vr::HmdMatrix34_t &mat)
+	{
+		const float (&m)[3][4] = mat.m;
+		vr::HmdQuaternionf_t q;
+		float trace = m[0][0] + m[1][1] + m[2][2];
+		if (trace > 0)
+		{
+			float s = 0.5f / sqrtf(trace + 1.0f);
+			q.w = 0.25f / s;
+			q.x = (m[2][1] - m[1][2]) * s;
+			q.y = (m[0][2] - m[2][0]) * s;
+			q.z = (m[1][0] - m[0][1]) * s;
+		}
+		else if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+		{
+			float s = 2.0f * sqrtf(1.0f + m[0][0] - m[1][1] - m[2][2]);
+			q.w = (m[2][1] - m[1][2]) / s;
+			q.x = 0.25f * s;
+			q.y = (m[0][1] + m[1][0]) / s;
+			q.z = (m[0][2] + m[2][0]) / s;
+		}
+		else if (m[1][1] > m[2][2])
+		{
+			float s = 2.0f * sqrtf(1.0f + m[1][1] - m[0][0] - m[2][2]);
+			q.w = (m[0][2] - m[2][0]) / s;
+			q.x = (m[0][1] + m[1][0]) / s;
+			q.y = 0.25f * s;
+			q.z = (m[1][2] + m[2][1]) / s;
+		}
+		else
+		{
+			float s = 2.0f * sqrtf(1.0f + m[2][2] - m[0][0] - m[1][1]);
+			q.w = (m[1][0] - m[0][1]) / s;
+			q.x = (m[0][2] + m[2][0]) / s;
+			q.y = (m[1][2] + m[2][1]) / s;
+			q.z = 0.25f * s;
+		}
+		return q;
+	}
+
+	inline vr::HmdMatrix34_t MatrixFromPose(const vr::HmdQuaternionf_t &q, const vr::HmdVector3_t &position)
+	{
+		vr::HmdMatrix34_t mat;
+		mat.m[0][0] = 1 - 2 * (q.y * q.y + q.z * q.z);
+		mat.m[0][1] = 2 * (q.x * q.y - q.z * q.w);
+		mat.m[0][2] = 2 * (q.x * q.z + q.y * q.w);
+		mat.m[1][0] = 2 * (q.x * q.y + q.z * q.w);
+		mat.m[1][1] = 1 - 2 * (q.x * q.x + q.z * q.z);
+		mat.m[1][2] = 2 * (q.y * q.z - q.x * q.w);
+		mat.m[2][0] = 2 * (q.x * q.z - q.y * q.w);
+		mat.m[2][1] = 2 * (q.y * q.z + q.x * q.w);
+		mat.m[2][2] = 1 - 2 * (q.x * q.x + q.y * q.y);
+		mat.m[0][3] = position.v[0];
+		mat.m[1][3] = position.v[1];
+		mat.m[2][3] = position.v[2];
+		return mat;
+	}
+
+	inline vr::HmdQuaternionf_t Multiply(const vr::HmdQuaternionf_t &a, const vr::HmdQuaternionf_t &b)
+	{
+		return {
+			a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+			a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+			a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+			a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w
+		};
+	}
+
+	inline vr::HmdQuaternionf_t Normalized(const vr::HmdQuaternionf_t &q)
+	{
+		float length = sqrtf(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+		return { q.w / length, q.x / length, q.y / length, q.z / length };
+	}
+
+	// Shortest way from a to b, t from 0 to 1
+	inline vr::HmdQuaternionf_t Slerp(const vr::HmdQuaternionf_t &a, vr::HmdQuaternionf_t b, float t)
+	{
+		float cosAngle = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+		if (cosAngle < 0)
+		{
+			b = { -b.w, -b.x, -b.y, -b.z };
+			cosAngle = -cosAngle;
+		}
+
+		float weightA = 1 - t;
+		float weightB = t;
+		// Nearly the same rotation, lerping is just as good and doesn't divide by ~0
+		if (cosAngle < 0.9995f)
+		{
+			float angle = acosf(cosAngle);
+			float sinAngle = sinf(angle);
+			weightA = sinf((1 - t) * angle) / sinAngle;
+			weightB = sinf(t * angle) / sinAngle;
+		}
+
+		return Normalized({
+			weightA * a.w + weightB * b.w,
+			weightA * a.x + weightB * b.x,
+			weightA * a.y + weightB * b.y,
+			weightA * a.z + weightB * b.z
+		});
+	}
+
+	// Rotates q by a world space angular velocity in radians per second for the given time
+	inline vr::HmdQuaternionf_t Integrate(const vr::HmdQuaternionf_t &q, const vr::HmdVector3_t &angularVelocity, float seconds)
+	{
+		const float (&w)[3] = angularVelocity.v;
+		float speed = sqrtf(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+		if (speed * seconds < 1e-6f)
+			return q;
+
+		float halfAngle = speed * seconds * 0.5f;
+		float scale = sinf(halfAngle) / speed;
+		vr::HmdQuaternionf_t delta = { cosf(halfAngle), w[0] * scale, w[1] * scale, w[2] * scale };
+		return Normalized(Multiply(delta, q));
+	}
+
+	struct Sample
+	{
+		int64_t time;
+		vr::HmdVector3_t position;
+		vr::HmdQuaternionf_t orientation;
+		vr::HmdVector3_t velocity;
+		vr::HmdVector3_t angularVelocity;
+	};
+
+	inline int64_t Ticks(std::chrono::steady_clock::time_point time)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+	}
+
+	inline std::chrono::steady_clock::time_point FromTicks(int64_t ticks)
+	{
+		return std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(ticks)));
+	}
+
+	// Samples of one device. Each slot carries the number of the push that wrote it, a reader that
+	// finds another number knows the slot was overwritten while it read and ignores it, so reading
+	// never waits or retries.
+	class DeviceRing
+	{
+	public:
+		void Push(const Sample &sample)
+		{
+			const uint64_t index = m_Count.load(std::memory_order_relaxed);
+			Slot &slot = m_Slots[index % Capacity];
+
+			slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			slot.time.store(sample.time, std::memory_order_relaxed);
+			const float values[] = {
+				sample.position.v[0], sample.position.v[1], sample.position.v[2],
+				sample.orientation.w, sample.orientation.x, sample.orientation.y, sample.orientation.z,
+				sample.velocity.v[0], sample.velocity.v[1], sample.velocity.v[2],
+				sample.angularVelocity.v[0], sample.angularVelocity.v[1], sample.angularVelocity.v[2]
+			};
+			for (int i = 0; i < Values; ++i)
+				slot.values[i].store(values[i], std::memory_order_relaxed);
+
+			slot.sequence.store(index * 2 + 2, std::memory_order_release);
+			m_Count.store(index + 1, std::memory_order_release);
+		}
+
+		uint64_t Count() const { return m_Count.load(std::memory_order_acquire); }
+
+		// False if sample number index was overwritten or is being written
+		bool Read(uint64_t index, Sample &sample) const
+		{
+			const Slot &slot = m_Slots[index % Capacity];
+			if (slot.sequence.load(std::memory_order_acquire) != index * 2 + 2)
+				return false;
+
+			float values[Values];
+			sample.time = slot.time.load(std::memory_order_relaxed);
+			for (int i = 0; i < Values; ++i)
+				values[i] = slot.values[i].load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) != index * 2 + 2)
+				return false;
+
+			sample.position = { values[0], values[1], values[2] };
+			sample.orientation = { values[3], values[4], values[5], values[6] };
+			sample.velocity = { values[7], values[8], values[9] };
+			sample.angularVelocity = { values[10], values[11], values[12] };
+			return true;
+		}
+
+	private:
+		static constexpr int Values = 13;
+
+		struct Slot
+		{
+			std::atomic<uint64_t> sequence{ 0 };
+			std::atomic<int64_t> time{ 0 };
+			std::atomic<float> values[Values] = {};
+		};
+
+		Slot m_Slots[Capacity];
+		std::atomic<uint64_t> m_Count{ 0 };
+	};
+
+	class Store
+	{
+	public:
+		// Producer only, time is when the pose is for. Invalid poses are skipped, PoseAt bridges them.
+		void Push(Device device, std::chrono::steady_clock::time_point time, const vr::TrackedDevicePose_t &pose)
+		{
+			if (!pose.bPoseIsValid)
+				return;
+
+			const vr::HmdMatrix34_t &mat = pose.mDeviceToAbsoluteTracking;
+			Sample sample;
+			sample.time = Ticks(time);
+			sample.position = { mat.m[0][3], mat.m[1][3], mat.m[2][3] };
+			sample.orientation = QuaternionFromMatrix(mat);
+			sample.velocity = pose.vVelocity;
+			sample.angularVelocity = pose.vAngularVelocity;
+			m_Devices[device].Push(sample);
+		}
+
+		// When the newest sample is for, false if there's none yet
+		bool NewestTime(Device device, std::chrono::steady_clock::time_point &time) const
+		{
+			const DeviceRing &ring = m_Devices[device];
+			const uint64_t count = ring.Count();
+
+			Sample newest;
+			if (count == 0 || !ring.Read(count - 1, newest))
+				return false;
+
+			time = FromTicks(newest.time);
+			return true;
+		}
+
+		// The pose at the given time, false if it's before the oldest sample kept or too far after the newest
+		bool PoseAt(Device device, std::chrono::steady_clock::time_point time, vr::TrackedDevicePose_t &pose) const
+		{
+			const DeviceRing &ring = m_Devices[device];
+			const int64_t ticks = Ticks(time);
+			const uint64_t count = ring.Count();
+			const uint64_t oldest = count > Capacity ? count - Capacity : 0;
+
+			Sample newer;
+			if (count == 0 || !ring.Read(count - 1, newer))
+				return false;
+
+			if (ticks >= newer.time)
+			{
+				float seconds = (ticks - newer.time) / 1e9f;
+				if (seconds > MaxExtrapolationSeconds)
+					return false;
+
+				Sample extrapolated = newer;
+				for (int i = 0; i < 3; ++i)
+					extrapolated.position.v[i] += newer.velocity.v[i] * seconds;
+				extrapolated.orientation = Integrate(newer.orientation, newer.angularVelocity, seconds);
+				ToPose(extrapolated, pose);
+				return true;
+			}
+
+			// Newest to oldest, until a sample at or before the time turns up
+			for (uint64_t index = count - 1; index-- > oldest;)
+			{
+				Sample older;
+				if (!ring.Read(index, older))
+					return false;
+
+				if (older.time <= ticks)
+				{
+					float t = newer.time > older.time ? (float)(ticks - older.time) / (newer.time - older.time) : 0;
+					Sample interpolated;
+					interpolated.time = ticks;
+					for (int i = 0; i < 3; ++i)
+					{
+						interpolated.position.v[i] = older.position.v[i] + (newer.position.v[i] - older.position.v[i]) * t;
+						interpolated.velocity.v[i] = older.velocity.v[i] + (newer.velocity.v[i] - older.velocity.v[i]) * t;
+						interpolated.angularVelocity.v[i] = older.angularVelocity.v[i] + (newer.angularVelocity.v[i] - older.angularVelocity.v[i]) * t;
+					}
+					interpolated.orientation = Slerp(older.orientation, newer.orientation, t);
+					ToPose(interpolated, pose);
+					return true;
+				}
+
+				newer = older;
+			}
+
+			return false;
+		}
+
+	private:
+		DeviceRing m_Devices[DeviceCount];
+
+		static void ToPose(const Sample &sample, vr::TrackedDevicePose_t &pose)
+		{
+			pose.mDeviceToAbsoluteTracking = MatrixFromPose(sample.orientation, sample.position);
+			pose.vVelocity = sample.velocity;
+			pose.vAngularVelocity = sample.angularVelocity;
+			pose.eTrackingResult = vr::TrackingResult_Running_OK;
+			pose.bPoseIsValid = true;
+			pose.bDeviceIsConnected = true;
+		}
+	};
+}
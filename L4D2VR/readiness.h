@@ -0,0 +1,394 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// Reports module loads to Readiness. The callback may be called from any thread, with the
+// loader lock held, so it only records the load.
+class IModuleSource
+{
+public:
+	virtual ~IModuleSource() = default;
+
+	// Reports every load from now on, false if this source can't
+	virtual bool Start(std::function<void(const std::string &name)> onLoaded) = 0;
+
+	// For modules loaded before Start
+	virtual bool IsLoaded(const std::string &name) const = 0;
+};
+
+// Tells init code the moment a module or the D3D device it depends on is there, instead of it
+// polling with Sleep. Also keeps a timeline of the init phases.
+// Dependency names are case-insensitive. Anything not registered as a probe is a module name.
+class Readiness
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Set by the renderer, nothing reports it so it's probed
+	static constexpr const char *D3DDevice = "d3d9 device";
+
+	// How often probes are checked while any are outstanding
+	static constexpr std::chrono::milliseconds ProbeInterval{ 1 };
+
+	Readiness(std::unique_ptr<IModuleSource> source)
+		: m_Source(std::move(source))
+	{
+		m_Start = Clock::now();
+		m_SourceStarted = m_Source && m_Source->Start([this](const std::string &name) { Signal(name); });
+		m_Worker = std::thread([this] { Run(); });
+	}
+
+	Readiness(const Readiness &) = delete;
+	Readiness &operator=(const Readiness &) = delete;
+
+	~Readiness()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Wake.notify_all();
+		m_Worker.join();
+
+		// The source may call Signal until it's gone, which needs the members below it
+		m_Source.reset();
+	}
+
+	// Something that becomes ready without an event, checked every ProbeInterval until it returns true
+	void AddProbe(const std::string &name, std::function<bool()> probe)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (!m_Ready.count(Key(name)))
+				m_Probes[Key(name)] = std::move(probe);
+		}
+		m_Wake.notify_all();
+	}
+
+	// Marks a dependency ready, for backends and for tests
+	void Signal(const std::string &name)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Pending.push_back(Key(name));
+		}
+		m_Wake.notify_all();
+	}
+
+	bool IsReady(const std::string &name)
+	{
+		const std::string key = Key(name);
+		if (CheckLoaded(key))
+			return true;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Ready.count(key) != 0;
+	}
+
+	void Wait(const std::string &name)
+	{
+		const std::string key = Key(name);
+		CheckLoaded(key);
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Changed.wait(lock, [&] { return m_Ready.count(key) != 0; });
+	}
+
+	// Runs callback on the readiness thread once the dependency is ready, right away if it already is.
+	// Callbacks must not Wait on anything, that would hold up every other notification.
+	void OnReady(const std::string &name, std::function<void()> callback)
+	{
+		const std::string key = Key(name);
+		CheckLoaded(key);
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (!m_Ready.count(key))
+			{
+				m_Callbacks[key].push_back(std::move(callback));
+				return;
+			}
+		}
+		callback();
+	}
+
+	// Adds a phase to the timeline, at the time it's called. The init TaskGraph reports its tasks here.
+	void Mark(const std::string &phase)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Timeline.push_back({ phase, Clock::now() });
+	}
+
+	void PrintTimeline()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		std::cout << "Startup timeline:\n";
+		for (const Phase &phase : m_Timeline)
+		{
+			std::chrono::duration<double, std::milli> elapsed = phase.time - m_Start;
+			std::cout << "  " << elapsed.count() << " ms: " << phase.name << "\n";
+		}
+	}
+
+private:
+	struct Phase
+	{
+		std::string name;
+		Clock::time_point time;
+	};
+
+	std::unique_ptr<IModuleSource> m_Source;
+	bool m_SourceStarted = false;
+	Clock::time_point m_Start;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::condition_variable m_Changed;
+	std::set<std::string> m_Ready;
+	std::vector<std::string> m_Pending;
+	std::map<std::string, std::function<bool()>> m_Probes;
+	std::map<std::string, std::vector<std::function<void()>>> m_Callbacks;
+	std::vector<Phase> m_Timeline;
+	bool m_Stopping = false;
+
+	std::thread m_Worker;
+
+	static std::string Key(std::string name)
+	{
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+		return name;
+	}
+
+	// Modules loaded before the source started never get reported, ask for them directly.
+	// Without a working source every module is probed instead.
+	// True if it found the module loaded, the readiness thread may not have marked it ready yet.
+	bool CheckLoaded(const std::string &key)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Ready.count(key) || m_Probes.count(key) || key == D3DDevice)
+				return false;
+		}
+
+		if (!m_Source)
+			return false;
+
+		// Not under m_Mutex, this can take the loader lock while the source holds it and waits for m_Mutex
+		if (m_Source->IsLoaded(key))
+		{
+			Signal(key);
+			return true;
+		}
+
+		if (!m_SourceStarted)
+			AddProbe(key, [this, key] { return m_Source && m_Source->IsLoaded(key); });
+		return false;
+	}
+
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (!m_Stopping)
+		{
+			for (auto it = m_Probes.begin(); it != m_Probes.end();)
+			{
+				if (it->second())
+				{
+					m_Pending.push_back(it->first);
+					it = m_Probes.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+
+			std::vector<std::function<void()>> callbacks;
+			for (const std::string &key : m_Pending)
+			{
+				if (!m_Ready.insert(key).second)
+					continue;
+
+				m_Timeline.push_back({ key + " ready", Clock::now() });
+				auto pending = m_Callbacks.find(key);
+				if (pending != m_Callbacks.end())
+				{
+					std::move(pending->second.begin(), pending->second.end(), std::back_inserter(callbacks));
+					m_Callbacks.erase(pending);
+				}
+			}
+			m_Pending.clear();
+			m_Changed.notify_all();
+
+			if (!callbacks.empty())
+			{
+				lock.unlock();
+				for (std::function<void()> &callback : callbacks)
+					callback();
+				lock.lock();
+				continue;
+			}
+
+			auto wakeUp = [this] { return m_Stopping || !m_Pending.empty(); };
+			if (m_Probes.empty())
+				m_Wake.wait(lock, [this] { return m_Stopping || !m_Pending.empty() || !m_Probes.empty(); });
+			else
+				m_Wake.wait_for(lock, ProbeInterval, wakeUp);
+		}
+	}
+};
+
+#ifdef _WIN32
+// Loader notifications from ntdll. A module is reported as soon as it's mapped, the same point
+// GetModuleHandle starts returning it.
+class LoaderModuleSource : public IModuleSource
+{
+public:
+	~LoaderModuleSource()
+	{
+		if (m_Cookie && m_Unregister)
+			m_Unregister(m_Cookie);
+	}
+
+	bool Start(std::function<void(const std::string &name)> onLoaded) override
+	{
+		HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+		auto registerNotification = (tLdrRegisterDllNotification)GetProcAddress(ntdll, "LdrRegisterDllNotification");
+		m_Unregister = (tLdrUnregisterDllNotification)GetProcAddress(ntdll, "LdrUnregisterDllNotification");
+		if (!registerNotification || !m_Unregister)
+			return false;
+
+		m_OnLoaded = std::move(onLoaded);
+		return registerNotification(0, &LoaderModuleSource::OnNotification, this, &m_Cookie) == 0;
+	}
+
+	bool IsLoaded(const std::string &name) const override
+	{
+		return GetModuleHandleA(name.c_str()) != NULL;
+	}
+
+private:
+	// Not in the SDK headers
+	struct LdrString
+	{
+		USHORT Length;
+		USHORT MaximumLength;
+		PWSTR Buffer;
+	};
+
+	struct LdrNotificationData
+	{
+		ULONG Flags;
+		const LdrString *FullDllName;
+		const LdrString *BaseDllName;
+		PVOID DllBase;
+		ULONG SizeOfImage;
+	};
+
+	static constexpr ULONG ReasonLoaded = 1;
+
+	typedef VOID(CALLBACK *tLdrNotification)(ULONG reason, const LdrNotificationData *data, PVOID context);
+	typedef LONG(NTAPI *tLdrRegisterDllNotification)(ULONG flags, tLdrNotification callback, PVOID context, PVOID *cookie);
+	typedef LONG(NTAPI *tLdrUnregisterDllNotification)(PVOID cookie);
+
+	std::function<void(const std::string &name)> m_OnLoaded;
+	tLdrUnregisterDllNotification m_Unregister = nullptr;
+	PVOID m_Cookie = nullptr;
+
+	// Runs with the loader lock held
+	static VOID CALLBACK OnNotification(ULONG reason, const LdrNotificationData *data, PVOID context)
+	{
+		if (reason != ReasonLoaded || !data->BaseDllName)
+			return;
+
+		const LdrString &baseName = *data->BaseDllName;
+		std::string name(baseName.Length / sizeof(WCHAR), '\0');
+		for (size_t i = 0; i < name.size(); ++i)
+			name[i] = (char)baseName.Buffer[i];
+
+		((LoaderModuleSource *)context)->m_OnLoaded(name);
+	}
+};
+#endif
+
+// Reports loads from a list of (delay, name) steps on its own thread, for running init code
+// without the game
+class ScriptedModuleSource : public IModuleSource
+{
+public:
+	struct Step
+	{
+		std::chrono::milliseconds delay;
+		std::string name;
+	};
+
+	// loaded are there before Start, like the modules the game loaded before us
+	ScriptedModuleSource(std::vector<Step> script, const std::vector<std::string> &loaded = {})
+		: m_Script(std::move(script))
+	{
+		for (const std::string &name : loaded)
+			m_Loaded.insert(Key(name));
+	}
+
+	// Steps the script hasn't got to are never reported
+	~ScriptedModuleSource()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Wake.notify_all();
+		if (m_Thread.joinable())
+			m_Thread.join();
+	}
+
+	bool Start(std::function<void(const std::string &name)> onLoaded) override
+	{
+		m_Thread = std::thread([this, onLoaded]
+		{
+			for (const Step &step : m_Script)
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_Mutex);
+					if (m_Wake.wait_for(lock, step.delay, [this] { return m_Stopping; }))
+						return;
+					m_Loaded.insert(Key(step.name));
+				}
+				onLoaded(step.name);
+			}
+		});
+		return true;
+	}
+
+	bool IsLoaded(const std::string &name) const override
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Loaded.count(Key(name)) != 0;
+	}
+
+private:
+	std::vector<Step> m_Script;
+	std::set<std::string> m_Loaded;
+	bool m_Stopping = false;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::thread m_Thread;
+
+	static std::string Key(std::string name)
+	{
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)tolower(c); });
+		return name;
+	}
+};
@@ -0,0 +1,150 @@
+#pragma once
+#include <cmath>
+#include "openvr.h"
+#include "vector.h"
+
+// An orientation as a unit quaternion in Source's axes, x forward, y left, z up. Orientations are
+// composed as quaternions and only turned into QAngles where the engine takes angles.
+struct Rotation
+{
+	float x = 0;
+	float y = 0;
+	float z = 0;
+	float w = 1;
+
+	// Same rotation as AngleMatrix, yaw * pitch * roll
+	static Rotation FromAngles(const QAngle &angles)
+	{
+		float sp, cp, sy, cy, sr, cr;
+		SinCos(DEG2RAD(angles.x) * 0.5f, &sp, &cp);
+		SinCos(DEG2RAD(angles.y) * 0.5f, &sy, &cy);
+		SinCos(DEG2RAD(angles.z) * 0.5f, &sr, &cr);
+
+		Rotation rotation;
+		rotation.x = sr * cp * cy - cr * sp * sy;
+		rotation.y = cr * sp * cy + sr * cp * sy;
+		rotation.z = cr * cp * sy - sr * sp * cy;
+		rotation.w = cr * cp * cy + sr * sp * sy;
+		return rotation;
+	}
+
+	// The rotation part of a matrix whose columns are forward, left and up
+	static Rotation FromMatrix(const matrix3x4_t &matrix)
+	{
+		const float m[3][3] = {
+			{ matrix[0][0], matrix[0][1], matrix[0][2] },
+			{ matrix[1][0], matrix[1][1], matrix[1][2] },
+			{ matrix[2][0], matrix[2][1], matrix[2][2] }
+		};
+		return FromRows(m);
+	}
+
+	// A device's orientation from its OpenVR pose, whose axes are x right, y up, z back
+	static Rotation FromTrackingMatrix(const vr::HmdMatrix34_t &matrix)
+	{
+		// Source axis i is OpenVR axis index[i] times sign[i], same swizzle as the position in GetPoseData
+		const int index[3] = { 2, 0, 1 };
+		const float sign[3] = { -1, -1, 1 };
+
+		float m[3][3];
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 3; ++column)
+				m[row][column] = sign[row] * sign[column] * matrix.m[index[row]][index[column]];
+		}
+		return FromRows(m);
+	}
+
+	// Applies other first, then this
+	Rotation operator*(const Rotation &other) const
+	{
+		Rotation rotation;
+		rotation.x = w * other.x + x * other.w + y * other.z - z * other.y;
+		rotation.y = w * other.y - x * other.z + y * other.w + z * other.x;
+		rotation.z = w * other.z + x * other.y - y * other.x + z * other.w;
+		rotation.w = w * other.w - x * other.x - y * other.y - z * other.z;
+		return rotation;
+	}
+
+	Vector Forward() const
+	{
+		return Vector(1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y));
+	}
+
+	Vector Right() const
+	{
+		return Vector(-2 * (x * y - w * z), -(1 - 2 * (x * x + z * z)), -2 * (y * z + w * x));
+	}
+
+	Vector Up() const
+	{
+		return Vector(2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y));
+	}
+
+	// Like QAngle::AngleVectors
+	void Axes(Vector *forward, Vector *right, Vector *up) const
+	{
+		if (forward)
+			*forward = Forward();
+		if (right)
+			*right = Right();
+		if (up)
+			*up = Up();
+	}
+
+	// Pitch, yaw and roll, for handing to the engine. Only pointing exactly straight up or down
+	// yaw and roll can't be told apart, composing rotations never goes through angles so that's
+	// only a concern where the engine gets them.
+	QAngle ToAngles() const
+	{
+		Vector forward = Forward();
+		float leftZ = 2 * (y * z + w * x);
+		float upZ = 1 - 2 * (x * x + y * y);
+		float xyDist = sqrtf(forward.x * forward.x + forward.y * forward.y);
+
+		return QAngle(
+			RAD2DEG(atan2f(-forward.z, xyDist)),
+			RAD2DEG(atan2f(forward.y, forward.x)),
+			RAD2DEG(atan2f(leftZ, upZ)));
+	}
+
+private:
+	static Rotation FromRows(const float (&m)[3][3])
+	{
+		Rotation rotation;
+		float trace = m[0][0] + m[1][1] + m[2][2];
+		if (trace > 0)
+		{
+			float s = 0.5f / sqrtf(trace + 1.0f);
+			rotation.w = 0.25f / s;
+			rotation.x = (m[2][1] - m[1][2]) * s;
+			rotation.y = (m[0][2] - m[2][0]) * s;
+			rotation.z = (m[1][0] - m[0][1]) * s;
+		}
+		else if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+		{
+			float s = 2.0f * sqrtf(1.0f + m[0][0] - m[1][1] - m[2][2]);
+			rotation.w = (m[2][1] - m[1][2]) / s;
+			rotation.x = 0.25f * s;
+			rotation.y = (m[0][1] + m[1][0]) / s;
+			rotation.z = (m[0][2] + m[2][0]) / s;
+		}
+		else if (m[1][1] > m[2][2])
+		{
+			float s = 2.0f * sqrtf(1.0f + m[1][1] - m[0][0] - m[2][2]);
+			rotation.w = (m[0][2] - m[2][0]) / s;
+			rotation.x = (m[0][1] + m[1][0]) / s;
+			rotation.y = 0.25f * s;
+			rotation.z = (m[1][2] + m[2][1]) / s;
+		}
+		else
+		{
+			float s = 2.0f * sqrtf(1.0f + m[2][2] - m[0][0] - m[1][1]);
+			rotation.w = (m[1][0] - m[0][1]) / s;
+			rotation.x = (m[0][2] + m[2][0]) / s;
+			rotation.y = (m[1][2] + m[2][1]) / s;
+			rotation.z = 0.25f * s;
+		}
+		return rotation;
+	}
+};
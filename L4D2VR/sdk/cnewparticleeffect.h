@@ -11,14 +11,14 @@ class CNewParticleEffect
 public:
 	inline void SetControlPoint(int nWhichPoint, const Vector& v) {
 		typedef int(__thiscall* tSetControlPoint)(void* thisptr, int nWhichPoint, const Vector& v);
-		static tSetControlPoint oSetControlPoint = (tSetControlPoint)(g_Game->m_Offsets->SetControlPoint.address);
+		static tSetControlPoint oSetControlPoint = (tSetControlPoint)(g_Game->m_Offsets->SetControlPoint.Address());
 
 		oSetControlPoint(this, nWhichPoint, v);
 	};
 
 	inline void StopEmission(bool bInfiniteOnly = false, bool bRemoveAllParticles = false, bool bWakeOnStop = false, bool bPlayEndCap = false) {
 		typedef int(__thiscall* tStopEmission)(void* thisptr, bool bInfiniteOnly, bool bRemoveAllParticles, bool bWakeOnStop, bool bPlayEndCap);
-		static tStopEmission oStopEmission = (tStopEmission)(g_Game->m_Offsets->StopEmission.address);
+		static tStopEmission oStopEmission = (tStopEmission)(g_Game->m_Offsets->StopEmission.Address());
 
 		oStopEmission(this, bInfiniteOnly, bRemoveAllParticles, bWakeOnStop, bPlayEndCap);
 	};
@@ -1,68 +1,533 @@
 #pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <emmintrin.h>
+#include <immintrin.h>
+#include "peimage.h"
+
+#ifdef _WIN32
 #include <Windows.h>
 #include <psapi.h>
-#include <vector>
-#include <sstream>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIGSCANNER_AVX2_TARGET
+#else
+#define SIGSCANNER_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+// An IDA-style signature ("55 8B EC ? ?") split into bytes and a mask.
+// A mask byte of 0xFF must match, 0x00 is a wildcard.
+// Fixed size so it can be parsed at compile time and kept in constexpr tables.
+struct Pattern
+{
+	static constexpr size_t MaxSize = 128;
+
+	uint8_t bytes[MaxSize] = {};
+	uint8_t mask[MaxSize] = {};
+	size_t length = 0;
+
+	// Index of the rarest non-wildcard byte, used as the search anchor.
+	size_t anchor = 0;
+	// Second non-wildcard byte tested together with the anchor to cut down on false candidates.
+	size_t filter = 0;
+
+	constexpr size_t size() const { return length; }
+
+	// Throws on malformed input, which turns into a compile error when used through _sig.
+	static constexpr Pattern Parse(const char *signature, size_t signatureLength)
+	{
+		Pattern pattern;
+
+		size_t i = 0;
+		while (i < signatureLength)
+		{
+			if (signature[i] == ' ')
+			{
+				++i;
+				continue;
+			}
+
+			if (pattern.length == MaxSize)
+				throw std::length_error("Signature is longer than Pattern::MaxSize");
+
+			if (signature[i] == '?')
+			{
+				i += (i + 1 < signatureLength && signature[i + 1] == '?') ? 2 : 1;
+				pattern.bytes[pattern.length] = 0;
+				pattern.mask[pattern.length] = 0;
+			}
+			else
+			{
+				int high = HexDigit(signature[i]);
+				int low = i + 1 < signatureLength ? HexDigit(signature[i + 1]) : -1;
+				if (high < 0 || low < 0)
+					throw std::invalid_argument("Signature bytes must be two hex digits or ?");
+
+				i += 2;
+				pattern.bytes[pattern.length] = (uint8_t)(high * 16 + low);
+				pattern.mask[pattern.length] = 0xFF;
+			}
+
+			if (i < signatureLength && signature[i] != ' ')
+				throw std::invalid_argument("Signature bytes must be separated by spaces");
+
+			++pattern.length;
+		}
+
+		if (pattern.length == 0)
+			throw std::invalid_argument("Signature is empty");
+
+		pattern.PickAnchors();
+		return pattern;
+	}
+
+	static Pattern Parse(const std::string &signature)
+	{
+		return Parse(signature.c_str(), signature.size());
+	}
+
+	static constexpr int HexDigit(char c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		return -1;
+	}
+
+	bool MatchesAt(const uint8_t *p) const
+	{
+		const size_t len = length;
+		size_t i = 0;
+
+		for (; i + 16 <= len; i += 16)
+		{
+			__m128i data = _mm_loadu_si128((const __m128i *)(p + i));
+			__m128i diff = _mm_xor_si128(data, _mm_loadu_si128((const __m128i *)(bytes + i)));
+			diff = _mm_and_si128(diff, _mm_loadu_si128((const __m128i *)(mask + i)));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF)
+				return false;
+		}
+
+		for (; i < len; ++i)
+		{
+			if ((p[i] ^ bytes[i]) & mask[i])
+				return false;
+		}
+		return true;
+	}
+
+	// Rough rank of how common a byte is in 32-bit MSVC code, most common first.
+	// Bytes not listed are treated as rare.
+	static constexpr uint8_t CommonBytes[] = {
+		0x00, 0xFF, 0x8B, 0xCC, 0x89, 0x24, 0x04, 0x83, 0x08, 0x45, 0xE8, 0x0F, 0x85, 0x44, 0x01,
+		0x10, 0x74, 0x55, 0xEC, 0xC3, 0x50, 0x56, 0x57, 0x53, 0x8D, 0x75, 0x0C, 0x5D, 0xC0, 0x33,
+		0xF1, 0x6A, 0x14, 0x18, 0x20, 0x40, 0x80, 0xC7, 0x46, 0x4D, 0x7D, 0xF8, 0xFC, 0x02, 0x03,
+		0x5E, 0x5F, 0x51, 0x52, 0x84, 0xC4, 0x0D, 0xE4, 0xF0, 0x1C, 0x06, 0x30
+	};
+
+	static constexpr int ByteFrequency(uint8_t b)
+	{
+		for (int i = 0; i < (int)sizeof(CommonBytes); ++i)
+		{
+			if (CommonBytes[i] == b)
+				return (int)sizeof(CommonBytes) - i;
+		}
+		return 0;
+	}
+
+	constexpr void PickAnchors()
+	{
+		int bestFreq = INT32_MAX;
+		for (size_t i = 0; i < length; ++i)
+		{
+			if (mask[i] && ByteFrequency(bytes[i]) < bestFreq)
+			{
+				bestFreq = ByteFrequency(bytes[i]);
+				anchor = i;
+			}
+		}
+
+		// Use the significant byte farthest from the anchor as the filter, two bytes
+		// that are far apart are less likely to be correlated.
+		filter = anchor;
+		size_t bestDistance = 0;
+		for (size_t i = 0; i < length; ++i)
+		{
+			size_t distance = i > anchor ? i - anchor : anchor - i;
+			if (mask[i] && distance > bestDistance)
+			{
+				bestDistance = distance;
+				filter = i;
+			}
+		}
+	}
+};
+
+// A signature parsed at compile time: "55 8B EC ? ?"_sig. The text is kept for error messages
+// and as the offset cache key.
+struct Signature
+{
+	const char *text;
+	Pattern pattern;
+};
+
+constexpr Signature operator""_sig(const char *text, size_t length)
+{
+	return { text, Pattern::Parse(text, length) };
+}
+
+// Result of a multi-pattern scan: the first match and how many times the pattern matched.
+struct PatternMatches
+{
+	size_t first = (size_t)-1;
+	int count = 0;
+};
 
 class SigScanner
 {
 public:
-	// Returns 0 if current offset matches, -1 if no matches found.
-	// A value > 0 is the new offset.
-	static int VerifyOffset(std::string moduleName, int currentOffset, std::string signature, int sigOffset = 0)
+	static constexpr size_t npos = (size_t)-1;
+
+	static inline int CountTrailingZeros(uint32_t value)
 	{
-		HMODULE hModule = GetModuleHandle(moduleName.c_str());
-		MODULEINFO moduleInfo;
-		GetModuleInformation(GetCurrentProcess(), hModule, &moduleInfo, sizeof(moduleInfo));
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return (int)index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+
+	static bool HasAVX2()
+	{
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 0);
+		if (regs[0] < 7)
+			return false;
 
-		uint8_t *bytes = (uint8_t *)moduleInfo.lpBaseOfDll;
+		__cpuid(regs, 1);
+		const bool osxsave = (regs[2] & (1 << 27)) != 0;
+		const bool avx = (regs[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
 
-		std::vector<int> pattern;
+		__cpuidex(regs, 7, 0);
+		return (regs[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	// Reference implementation, kept for benchmarking and as the tail loop of the vector scanners.
+	static size_t FindPatternScalar(const uint8_t *data, size_t size, const Pattern &pattern, size_t start = 0)
+	{
+		const size_t len = pattern.size();
+		if (len == 0 || size < len)
+			return npos;
 
-		std::stringstream ss(signature);
-		std::string sigByte;
-		while (ss >> sigByte)
+		for (size_t i = start; i <= size - len; ++i)
 		{
-			if (sigByte == "?" || sigByte == "??")
-				pattern.push_back(-1);
-			else
-				pattern.push_back(strtoul(sigByte.c_str(), NULL, 16));
+			if (pattern.MatchesAt(data + i))
+				return i;
 		}
+		return npos;
+	}
 
-		int patternLen = pattern.size();
+	static size_t FindPatternSSE2(const uint8_t *data, size_t size, const Pattern &pattern, size_t start = 0)
+	{
+		const size_t len = pattern.size();
+		if (len == 0 || size < len)
+			return npos;
 
-		// Check if current offset is good
-		bool offsetMatchesSig = true;
-		for (int i = 0; i < patternLen; ++i)
+		if (!pattern.mask[pattern.anchor])
+			return FindPatternScalar(data, size, pattern, start);
+
+		const size_t last = size - len;
+		const __m128i anchor = _mm_set1_epi8((char)pattern.bytes[pattern.anchor]);
+		const __m128i filter = _mm_set1_epi8((char)pattern.bytes[pattern.filter]);
+
+		size_t i = start;
+		for (; i + 16 <= last + 1; i += 16)
 		{
-			if ( (bytes[currentOffset - sigOffset + i] != pattern[i]) && (pattern[i] != -1) )
+			__m128i a = _mm_cmpeq_epi8(anchor, _mm_loadu_si128((const __m128i *)(data + i + pattern.anchor)));
+			__m128i f = _mm_cmpeq_epi8(filter, _mm_loadu_si128((const __m128i *)(data + i + pattern.filter)));
+			uint32_t candidates = (uint32_t)_mm_movemask_epi8(_mm_and_si128(a, f));
+
+			while (candidates)
 			{
-				offsetMatchesSig = false;
-				break;
+				size_t pos = i + CountTrailingZeros(candidates);
+				if (pattern.MatchesAt(data + pos))
+					return pos;
+				candidates &= candidates - 1;
 			}
 		}
 
-		if (offsetMatchesSig)
-			return 0;
+		return FindPatternScalar(data, size, pattern, i);
+	}
+
+	SIGSCANNER_AVX2_TARGET
+	static size_t FindPatternAVX2(const uint8_t *data, size_t size, const Pattern &pattern, size_t start = 0)
+	{
+		const size_t len = pattern.size();
+		if (len == 0 || size < len)
+			return npos;
+
+		if (!pattern.mask[pattern.anchor])
+			return FindPatternScalar(data, size, pattern, start);
+
+		const size_t last = size - len;
+		const __m256i anchor = _mm256_set1_epi8((char)pattern.bytes[pattern.anchor]);
+		const __m256i filter = _mm256_set1_epi8((char)pattern.bytes[pattern.filter]);
+
+		size_t i = start;
+		for (; i + 32 <= last + 1; i += 32)
+		{
+			__m256i a = _mm256_cmpeq_epi8(anchor, _mm256_loadu_si256((const __m256i *)(data + i + pattern.anchor)));
+			__m256i f = _mm256_cmpeq_epi8(filter, _mm256_loadu_si256((const __m256i *)(data + i + pattern.filter)));
+			uint32_t candidates = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(a, f));
+
+			while (candidates)
+			{
+				size_t pos = i + CountTrailingZeros(candidates);
+				if (pattern.MatchesAt(data + pos))
+					return pos;
+				candidates &= candidates - 1;
+			}
+		}
 
-		// Scan the dll for new offset
-		for (int i = 0; i < moduleInfo.SizeOfImage; ++i)
+		return FindPatternSSE2(data, size, pattern, i);
+	}
+
+	// Returns the offset of the first match at or after 'start', or npos.
+	static size_t FindPattern(const uint8_t *data, size_t size, const Pattern &pattern, size_t start = 0)
+	{
+		static const bool hasAVX2 = HasAVX2();
+
+		if (hasAVX2)
+			return FindPatternAVX2(data, size, pattern, start);
+		return FindPatternSSE2(data, size, pattern, start);
+	}
+
+	// Resolves every pattern in a single pass over the image. Patterns are dispatched on the
+	// rarest pair of adjacent significant bytes (or a single byte when they have no such pair),
+	// so each image position costs one table lookup no matter how many patterns are searched.
+	// Only matches starting in [begin, end) are reported, so an image can be split into chunks
+	// that are scanned separately and merged with MergeMatches.
+	static std::vector<PatternMatches> FindPatterns(const uint8_t *data, size_t size, const std::vector<const Pattern *> &patterns,
+		size_t begin = 0, size_t end = npos)
+	{
+		struct Entry
 		{
-			bool found = true;
-			for (int j = 0; j < patternLen; ++j)
+			uint32_t pattern;
+			uint32_t keyPos;
+		};
+
+		std::vector<PatternMatches> results(patterns.size());
+
+		// Pick a dispatch key per pattern
+		std::vector<int> keys(patterns.size(), -1);
+		std::vector<uint32_t> keyPos(patterns.size(), 0);
+		std::vector<bool> pairKey(patterns.size(), false);
+		for (size_t p = 0; p < patterns.size(); ++p)
+		{
+			const Pattern &pattern = *patterns[p];
+			int bestFreq = INT32_MAX;
+			for (size_t i = 0; i + 1 < pattern.size(); ++i)
 			{
-				if ((bytes[i + j] != pattern[j]) && (pattern[j] != -1))
+				if (!pattern.mask[i] || !pattern.mask[i + 1])
+					continue;
+
+				int freq = Pattern::ByteFrequency(pattern.bytes[i]) + Pattern::ByteFrequency(pattern.bytes[i + 1]);
+				if (freq < bestFreq)
 				{
-					found = false;
-					break;
+					bestFreq = freq;
+					keys[p] = pattern.bytes[i] | (pattern.bytes[i + 1] << 8);
+					keyPos[p] = (uint32_t)i;
+					pairKey[p] = true;
 				}
 			}
-			if (found)
+
+			if (!pairKey[p] && pattern.size() && pattern.mask[pattern.anchor])
 			{
-				return i + sigOffset;
+				keys[p] = pattern.bytes[pattern.anchor];
+				keyPos[p] = (uint32_t)pattern.anchor;
 			}
 		}
-		return -1;
 
+		// Bucket the patterns by key (counting sort into flat arrays)
+		std::vector<uint32_t> pairStart(0x10000 + 1, 0);
+		std::vector<uint32_t> singleStart(0x100 + 1, 0);
+		for (size_t p = 0; p < patterns.size(); ++p)
+		{
+			if (keys[p] >= 0)
+				++(pairKey[p] ? pairStart : singleStart)[keys[p] + 1];
+		}
+		for (size_t k = 1; k < pairStart.size(); ++k)
+			pairStart[k] += pairStart[k - 1];
+		for (size_t k = 1; k < singleStart.size(); ++k)
+			singleStart[k] += singleStart[k - 1];
+
+		std::vector<Entry> pairEntries(pairStart.back());
+		std::vector<Entry> singleEntries(singleStart.back());
+		std::vector<uint32_t> pairFill(pairStart.begin(), pairStart.end() - 1);
+		std::vector<uint32_t> singleFill(singleStart.begin(), singleStart.end() - 1);
+		for (size_t p = 0; p < patterns.size(); ++p)
+		{
+			if (keys[p] < 0)
+				continue;
+
+			Entry entry = { (uint32_t)p, keyPos[p] };
+			if (pairKey[p])
+				pairEntries[pairFill[keys[p]]++] = entry;
+			else
+				singleEntries[singleFill[keys[p]]++] = entry;
+		}
+
+		size_t maxKeyPos = 0;
+		for (uint32_t pos : keyPos)
+			maxKeyPos = std::max<size_t>(maxKeyPos, pos);
+
+		end = std::min(end, size);
+		const size_t scanEnd = std::min(size, end + maxKeyPos);
+
+		auto check = [&](const Entry &entry, size_t i)
+		{
+			if (i < begin + entry.keyPos)
+				return;
+
+			const Pattern &pattern = *patterns[entry.pattern];
+			size_t start = i - entry.keyPos;
+			if (start >= end || start + pattern.size() > size || !pattern.MatchesAt(data + start))
+				return;
+
+			PatternMatches &result = results[entry.pattern];
+			if (result.count++ == 0)
+				result.first = start;
+		};
+
+		const bool hasSingles = !singleEntries.empty();
+		for (size_t i = begin; i < scanEnd; ++i)
+		{
+			if (i + 1 < size)
+			{
+				uint32_t key = data[i] | (data[i + 1] << 8);
+				for (uint32_t e = pairStart[key]; e < pairStart[key + 1]; ++e)
+					check(pairEntries[e], i);
+			}
+
+			if (hasSingles)
+			{
+				for (uint32_t e = singleStart[data[i]]; e < singleStart[data[i] + 1]; ++e)
+					check(singleEntries[e], i);
+			}
+		}
+
+		return results;
+	}
+
+	// Combines the results of two chunks of the same image
+	static void MergeMatches(PatternMatches &into, const PatternMatches &from)
+	{
+		if (from.count && (into.count == 0 || from.first < into.first))
+			into.first = from.first;
+		into.count += from.count;
+	}
+
+	static bool CheckOffset(const uint8_t *bytes, size_t size, int currentOffset, const Pattern &pattern, int sigOffset = 0)
+	{
+		int start = currentOffset - sigOffset;
+		return start >= 0 && (size_t)start + pattern.size() <= size && pattern.MatchesAt(bytes + start);
+	}
+
+	// Region aware versions of the above for PE images, offsets are RVAs.
+	// A match never spans two regions.
+	static bool CheckOffset(const std::vector<ImageRegion> &regions, int currentOffset, const Pattern &pattern, int sigOffset = 0)
+	{
+		const int64_t start = (int64_t)currentOffset - sigOffset;
+		for (const ImageRegion &region : regions)
+		{
+			if (start >= region.rva && start < (int64_t)region.rva + (int64_t)region.size)
+				return CheckOffset(region.data, region.size, (int)(start - region.rva), pattern);
+		}
+		return false;
+	}
+
+	static size_t FindPattern(const std::vector<ImageRegion> &regions, const Pattern &pattern)
+	{
+		for (const ImageRegion &region : regions)
+		{
+			size_t found = FindPattern(region.data, region.size, pattern);
+			if (found != npos)
+				return region.rva + found;
+		}
+		return npos;
+	}
+
+	static std::vector<PatternMatches> FindPatterns(const std::vector<ImageRegion> &regions, const std::vector<const Pattern *> &patterns)
+	{
+		std::vector<PatternMatches> results(patterns.size());
+		for (const ImageRegion &region : regions)
+		{
+			std::vector<PatternMatches> matches = FindPatterns(region.data, region.size, patterns);
+			for (size_t i = 0; i < matches.size(); ++i)
+			{
+				if (matches[i].count)
+					matches[i].first += region.rva;
+				MergeMatches(results[i], matches[i]);
+			}
+		}
+		return results;
+	}
+
+	// Executable sections of a PE image, or the whole buffer if it isn't one
+	static std::vector<ImageRegion> CodeRegions(const uint8_t *bytes, size_t size)
+	{
+		PEImage pe;
+		if (!pe.Parse(bytes, size))
+			return { { bytes, size, 0 } };
+		return pe.Regions(SectionKind::Code);
+	}
+
+	// Returns 0 if current offset matches, -1 if no matches found.
+	// A value > 0 is the new offset.
+	static int VerifyOffset(const uint8_t *bytes, size_t size, int currentOffset, const Pattern &pattern, int sigOffset = 0)
+	{
+		std::vector<ImageRegion> regions = CodeRegions(bytes, size);
+
+		// Check if current offset is good
+		if (CheckOffset(regions, currentOffset, pattern, sigOffset))
+			return 0;
+
+		// Scan the code sections of the dll for new offset
+		size_t found = FindPattern(regions, pattern);
+		if (found == npos)
+			return -1;
+
+		return (int)found + sigOffset;
+	}
+
+#ifdef _WIN32
+	static bool GetModuleImage(const std::string &moduleName, const uint8_t *&bytes, size_t &size)
+	{
+		HMODULE hModule = GetModuleHandle(moduleName.c_str());
+		MODULEINFO moduleInfo;
+		if (!hModule || !GetModuleInformation(GetCurrentProcess(), hModule, &moduleInfo, sizeof(moduleInfo)))
+			return false;
+
+		bytes = (const uint8_t *)moduleInfo.lpBaseOfDll;
+		size = moduleInfo.SizeOfImage;
+		return true;
 	}
-};
\ No newline at end of file
+#endif
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "threadpool.h"
+
+// A set of named tasks that each wait for the tasks they depend on, everything else runs in
+// parallel on a ThreadPool. Dependencies can only be tasks added before, so there are no cycles.
+// A task that throws fails, and everything depending on it is skipped.
+class TaskGraph
+{
+public:
+	// Told when each task starts, ends, fails or is skipped, from the thread the task runs on
+	using Observer = std::function<void(const std::string &event)>;
+
+	void SetObserver(Observer observer)
+	{
+		m_Observer = std::move(observer);
+	}
+
+	// Returns the id to depend on
+	int Add(const std::string &name, std::vector<int> dependencies, std::function<void()> run)
+	{
+		const int id = (int)m_Nodes.size();
+		for (int dependency : dependencies)
+		{
+			if (dependency < 0 || dependency >= id)
+				throw std::invalid_argument("Task " + name + " depends on a task that wasn't added before it");
+		}
+
+		Node node;
+		node.name = name;
+		node.run = std::move(run);
+		node.dependencyCount = (int)dependencies.size();
+		m_Nodes.push_back(std::move(node));
+
+		for (int dependency : dependencies)
+			m_Nodes[dependency].dependents.push_back(id);
+		return id;
+	}
+
+	// Blocks until every task finished or was skipped, false if any failed. Running the graph again
+	// runs every task again. Tasks may block, the pool needs a thread for every task that can run
+	// at the same time.
+	bool Run(ThreadPool &pool)
+	{
+		m_Pool = &pool;
+		m_Finished = 0;
+
+		std::vector<int> roots;
+		for (int i = 0; i < (int)m_Nodes.size(); ++i)
+		{
+			Node &node = m_Nodes[i];
+			node.remaining = node.dependencyCount;
+			node.error.clear();
+			node.blockedBy.clear();
+			if (node.remaining == 0)
+				roots.push_back(i);
+		}
+		for (int root : roots)
+			Schedule(root);
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Done.wait(lock, [this] { return m_Finished == m_Nodes.size(); });
+		return Errors().empty();
+	}
+
+	// One line per failed or skipped task
+	std::vector<std::string> Errors() const
+	{
+		std::vector<std::string> errors;
+		for (const Node &node : m_Nodes)
+		{
+			if (!node.error.empty())
+				errors.push_back(node.name + ": " + node.error);
+		}
+		return errors;
+	}
+
+private:
+	struct Node
+	{
+		std::string name;
+		std::function<void()> run;
+		std::vector<int> dependents;
+		int dependencyCount = 0;
+		// Dependencies that haven't finished in the current Run
+		int remaining = 0;
+
+		// What the task threw, or which dependency kept it from running
+		std::string error;
+		std::string blockedBy;
+	};
+
+	std::vector<Node> m_Nodes;
+	ThreadPool *m_Pool = nullptr;
+	Observer m_Observer;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Done;
+	size_t m_Finished = 0;
+
+	void Report(const std::string &event)
+	{
+		if (m_Observer)
+			m_Observer(event);
+	}
+
+	void Schedule(int id)
+	{
+		m_Pool->Submit([this, id] { Execute(id); });
+	}
+
+	void Execute(int id)
+	{
+		Node &node = m_Nodes[id];
+
+		// blockedBy is only written before the last dependency schedules this task
+		if (node.blockedBy.empty())
+		{
+			Report(node.name + " started");
+			try
+			{
+				node.run();
+			}
+			catch (const std::exception &e)
+			{
+				node.error = e.what();
+			}
+			catch (...)
+			{
+				node.error = "unknown exception";
+			}
+			Report(node.name + (node.error.empty() ? " done" : " failed, " + node.error));
+		}
+		else
+		{
+			node.error = "skipped, " + node.blockedBy + " failed";
+			Report(node.name + " " + node.error);
+		}
+
+		std::vector<int> ready;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (int dependent : node.dependents)
+			{
+				Node &next = m_Nodes[dependent];
+				if (!node.error.empty() && next.blockedBy.empty())
+					next.blockedBy = node.name;
+				if (--next.remaining == 0)
+					ready.push_back(dependent);
+			}
+			// Notified under the lock, Run may return and the graph go away as soon as it's released
+			++m_Finished;
+			m_Done.notify_all();
+		}
+
+		for (int dependent : ready)
+			Schedule(dependent);
+	}
+};
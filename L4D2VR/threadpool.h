@@ -0,0 +1,80 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run submitted jobs in FIFO order.
+// Jobs must not wait on other jobs of the same pool, all workers could end up waiting.
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned threadCount = 0)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+		for (unsigned i = 0; i < threadCount; ++i)
+			m_Workers.emplace_back([this] { WorkerLoop(); });
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Wake.notify_all();
+
+		for (std::thread &worker : m_Workers)
+			worker.join();
+	}
+
+	unsigned ThreadCount() const { return (unsigned)m_Workers.size(); }
+
+	template <typename F>
+	std::future<void> Submit(F job)
+	{
+		auto task = std::make_shared<std::packaged_task<void()>>(std::move(job));
+		std::future<void> result = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Jobs.emplace_back([task] { (*task)(); });
+		}
+		m_Wake.notify_one();
+		return result;
+	}
+
+private:
+	std::vector<std::thread> m_Workers;
+	std::deque<std::function<void()>> m_Jobs;
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	bool m_Stopping = false;
+
+	void WorkerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Wake.wait(lock, [this] { return m_Stopping || !m_Jobs.empty(); });
+				if (m_Jobs.empty())
+					return;
+
+				job = std::move(m_Jobs.front());
+				m_Jobs.pop_front();
+			}
+			job();
+		}
+	}
+};
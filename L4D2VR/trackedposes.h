@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <emmintrin.h>
+#include "openvr.h"
+
+// Every tracked device's pose in Source's axes, one array per component so groups of four devices
+// convert together in SSE lanes. Converting all of them costs the same as converting a few, the
+// orientation is only built for devices that ask for it.
+class TrackedPoses
+{
+public:
+	static constexpr uint32_t Count = vr::k_unMaxTrackedDeviceCount;
+	static_assert(Count % 4 == 0 && Count <= 64, "devices are converted in groups of four and tracked in a 64 bit mask");
+
+	// Meters and meters per second, x forward, y left, z up
+	alignas(16) float posX[Count];
+	alignas(16) float posY[Count];
+	alignas(16) float posZ[Count];
+	alignas(16) float velX[Count];
+	alignas(16) float velY[Count];
+	alignas(16) float velZ[Count];
+	// Degrees per second
+	alignas(16) float angVelX[Count];
+	alignas(16) float angVelY[Count];
+	alignas(16) float angVelZ[Count];
+	// Rotation part of mDeviceToAbsoluteTracking as is, rot[row][column]
+	alignas(16) float rot[3][3][Count];
+	// Bit i is set if device i's pose is valid
+	uint64_t valid = 0;
+
+	void Convert(const vr::TrackedDevicePose_t (&poses)[Count])
+	{
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		const __m128 degrees = _mm_set1_ps(180.0f / 3.141592654f);
+
+		uint64_t validMask = 0;
+		for (uint32_t i = 0; i < Count; i += 4)
+		{
+			const vr::TrackedDevicePose_t *group = poses + i;
+
+			_mm_store_ps(posX + i, _mm_xor_ps(sign, Lanes(group, [](const vr::TrackedDevicePose_t &pose) { return pose.mDeviceToAbsoluteTracking.m[2][3]; })));
+			_mm_store_ps(posY + i, _mm_xor_ps(sign, Lanes(group, [](const vr::TrackedDevicePose_t &pose) { return pose.mDeviceToAbsoluteTracking.m[0][3]; })));
+			_mm_store_ps(posZ + i, Lanes(group, [](const vr::TrackedDevicePose_t &pose) { return pose.mDeviceToAbsoluteTracking.m[1][3]; }));
+
+			_mm_store_ps(velX + i, _mm_xor_ps(sign, Lanes(group, [](const vr::TrackedDevicePose_t &pose) { return pose.vVelocity.v[2]; })));
+			_mm_store_ps(velY + i, _mm_xor_ps(sign, Lanes(group, [](const vr::TrackedDevicePose_t &pose) { return pose.vVelocity.v[0]; })));
+			_mm_store_ps(velZ + i, Lanes(group, [](const vr::TrackedDevicePose_t &pose) { return pose.vVelocity.v[1]; }));
+
+			_mm_store_ps(angVelX + i, _mm_mul_ps(degrees, _mm_xor_ps(sign, Lanes(group, [](const vr::TrackedDevicePose_t &pose) { return pose.vAngularVelocity.v[2]; }))));
+			_mm_store_ps(angVelY + i, _mm_mul_ps(degrees, _mm_xor_ps(sign, Lanes(group, [](const vr::TrackedDevicePose_t &pose) { return pose.vAngularVelocity.v[0]; }))));
+			_mm_store_ps(angVelZ + i, _mm_mul_ps(degrees, Lanes(group, [](const vr::TrackedDevicePose_t &pose) { return pose.vAngularVelocity.v[1]; })));
+
+			for (int row = 0; row < 3; ++row)
+			{
+				for (int column = 0; column < 3; ++column)
+					_mm_store_ps(rot[row][column] + i, Lanes(group, [=](const vr::TrackedDevicePose_t &pose) { return pose.mDeviceToAbsoluteTracking.m[row][column]; }));
+			}
+
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				if (group[lane].bPoseIsValid)
+					validMask |= 1ull << (i + lane);
+			}
+		}
+		valid = validMask;
+	}
+
+	bool IsValid(uint32_t device) const
+	{
+		return device < Count && (valid >> device & 1);
+	}
+
+	// mDeviceToAbsoluteTracking as OpenVR returned it
+	vr::HmdMatrix34_t Matrix(uint32_t device) const
+	{
+		vr::HmdMatrix34_t mat;
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 3; ++column)
+				mat.m[row][column] = rot[row][column][device];
+		}
+		mat.m[0][3] = -posY[device];
+		mat.m[1][3] = posZ[device];
+		mat.m[2][3] = -posX[device];
+		return mat;
+	}
+
+private:
+	template <typename Get>
+	static __m128 Lanes(const vr::TrackedDevicePose_t *group, Get get)
+	{
+		return _mm_setr_ps(get(group[0]), get(group[1]), get(group[2]), get(group[3]));
+	}
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include <cmath>
+#include "vector.h"
+
+// The spaces tracked positions go through on their way into the game, each one inside the next:
+//   Tracking  OpenVR's tracking space in Source's axes, meters
+//   PlayArea  game units, around the anchor the play area is centered on
+//   Player    turned by the yaw rotation offset, around the player's setup origin
+//   World     the game world
+// Setting a link to what it already is does nothing. Changing one only marks the transforms out of
+// tracking space that go through it dirty, they're composed again the next time they're asked for,
+// so a query is a single matrix-vector multiply.
+class TransformChain
+{
+public:
+	enum Space { Tracking, PlayArea, Player, World, SpaceCount };
+
+	TransformChain()
+	{
+		for (matrix3x4_t &link : m_Links)
+			link = Identity();
+		for (matrix3x4_t &transform : m_FromTracking)
+			transform = Identity();
+	}
+
+	// Tracking to play area, scale is game units per meter
+	void SetAnchor(const Vector &anchor, float scale)
+	{
+		if (Same(anchor, m_Anchor) && scale == m_Scale)
+			return;
+		m_Anchor = anchor;
+		m_Scale = scale;
+		m_Links[Tracking] = matrix3x4_t(
+			scale, 0, 0, -anchor.x * scale,
+			0, scale, 0, -anchor.y * scale,
+			0, 0, scale, -anchor.z * scale);
+		Dirty(Tracking);
+	}
+
+	// Play area to player, turns the same way as VectorPivotXY
+	void SetYaw(float degrees)
+	{
+		if (degrees == m_Yaw)
+			return;
+		m_Yaw = degrees;
+		float s = sinf(DEG2RAD(degrees));
+		float c = cosf(DEG2RAD(degrees));
+		m_Links[PlayArea] = matrix3x4_t(
+			c, -s, 0, 0,
+			s, c, 0, 0,
+			0, 0, 1, 0);
+		Dirty(PlayArea);
+	}
+
+	// Player to world
+	void SetOrigin(const Vector &origin)
+	{
+		if (Same(origin, m_Origin))
+			return;
+		m_Origin = origin;
+		m_Links[Player] = matrix3x4_t(
+			1, 0, 0, origin.x,
+			0, 1, 0, origin.y,
+			0, 0, 1, origin.z);
+		Dirty(Player);
+	}
+
+	// Takes tracking space into space
+	const matrix3x4_t &FromTracking(Space space)
+	{
+		for (; m_FirstDirty <= space; ++m_FirstDirty)
+			m_FromTracking[m_FirstDirty] = Concat(m_Links[m_FirstDirty - 1], m_FromTracking[m_FirstDirty - 1]);
+		return m_FromTracking[space];
+	}
+
+	Vector Point(Space space, const Vector &trackingPoint)
+	{
+		const matrix3x4_t &m = FromTracking(space);
+		return Vector(
+			m[0][0] * trackingPoint.x + m[0][1] * trackingPoint.y + m[0][2] * trackingPoint.z + m[0][3],
+			m[1][0] * trackingPoint.x + m[1][1] * trackingPoint.y + m[1][2] * trackingPoint.z + m[1][3],
+			m[2][0] * trackingPoint.x + m[2][1] * trackingPoint.y + m[2][2] * trackingPoint.z + m[2][3]);
+	}
+
+	// Offsets between points only scale and turn
+	Vector Direction(Space space, const Vector &trackingDirection)
+	{
+		const matrix3x4_t &m = FromTracking(space);
+		return Vector(
+			m[0][0] * trackingDirection.x + m[0][1] * trackingDirection.y + m[0][2] * trackingDirection.z,
+			m[1][0] * trackingDirection.x + m[1][1] * trackingDirection.y + m[1][2] * trackingDirection.z,
+			m[2][0] * trackingDirection.x + m[2][1] * trackingDirection.y + m[2][2] * trackingDirection.z);
+	}
+
+private:
+	// m_Links[i] takes space i into space i + 1
+	matrix3x4_t m_Links[SpaceCount - 1];
+	matrix3x4_t m_FromTracking[SpaceCount];
+	// m_FromTracking is up to date for the spaces before this one
+	int m_FirstDirty = SpaceCount;
+
+	Vector m_Anchor = { 0, 0, 0 };
+	float m_Scale = 1;
+	float m_Yaw = 0;
+	Vector m_Origin = { 0, 0, 0 };
+
+	// The link out of space changed, so did every transform out of tracking space past it
+	void Dirty(Space space)
+	{
+		if (space + 1 < m_FirstDirty)
+			m_FirstDirty = space + 1;
+	}
+
+	static bool Same(const Vector &a, const Vector &b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	static matrix3x4_t Identity()
+	{
+		return matrix3x4_t(
+			1, 0, 0, 0,
+			0, 1, 0, 0,
+			0, 0, 1, 0);
+	}
+
+	// b, then a
+	static matrix3x4_t Concat(const matrix3x4_t &a, const matrix3x4_t &b)
+	{
+		matrix3x4_t out;
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int column = 0; column < 4; ++column)
+			{
+				out[row][column] = a[row][0] * b[0][column] + a[row][1] * b[1][column] + a[row][2] * b[2][column];
+				if (column == 3)
+					out[row][column] += a[row][3];
+			}
+		}
+		return out;
+	}
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+
+// Hands the newest value from one producer thread to one consumer thread without either of them
+// waiting. The producer fills WriteBuffer() and publishes it, the consumer picks up whatever was
+// published last, values published in between are skipped.
+template <typename T>
+class TripleBuffer
+{
+public:
+	// Producer only
+	T &WriteBuffer() { return m_Buffers[m_Write]; }
+
+	void Publish()
+	{
+		m_Write = m_Middle.exchange(m_Write | Fresh, std::memory_order_acq_rel) & IndexMask;
+	}
+
+	// Consumer only, false if nothing was published since the last call
+	bool Update()
+	{
+		if (!(m_Middle.load(std::memory_order_relaxed) & Fresh))
+			return false;
+
+		m_Read = m_Middle.exchange(m_Read, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+
+	// Consumer only, stays the same until the next Update
+	const T &Read() const { return m_Buffers[m_Read]; }
+
+private:
+	static constexpr int IndexMask = 3;
+	// Set on the middle index while it holds a value the consumer hasn't seen
+	static constexpr int Fresh = 4;
+
+	T m_Buffers[3] = {};
+	int m_Write = 0;
+	std::atomic<int> m_Middle{ 1 };
+	int m_Read = 2;
+};
@@ -4,6 +4,9 @@
 #include "game.h"
 #include "hooks.h"
 #include "trace.h"
+#include "frametrace.h"
+#include "compositorsync.h"
+#include "readiness.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -18,10 +21,10 @@
 /**
  * @brief Constructs the VR system and initializes the VR settings.
  *
- * This constructor handles the initialization of the VR system, including setting up the VR
+ * This constructor handles the OpenVR side of the initialization, including setting up the VR
  * compositor, retrieving recommended render target sizes, calculating texture bounds, and
- * installing necessary application manifests. It also sets up the overlay for the main menu and
- * configures various VR settings.
+ * installing necessary application manifests. It doesn't need any game module, so it can run
+ * while the game is still loading. InitRendering() finishes the setup once the D3D device exists.
  *
  * @param game Pointer to the Game instance.
  */
@@ -84,9 +87,23 @@ VR::VR(Game *game)
 
     std::thread configParser(&VR::WaitForConfigUpdate, this);
     configParser.detach();
+}
+
+/**
+ * @brief Finishes the VR initialization that depends on the game.
+ *
+ * Waits for the D3D device, then sets up the overlay for the main menu, the tracking space and
+ * the first poses. Requires the game interfaces to be set up. Does nothing if the constructor
+ * failed to initialize OpenVR.
+ */
+void VR::InitRendering()
+{
+    // Only set once VR_Init and the compositor succeeded
+    if (!m_Input)
+        return;
 
-    while (!g_D3DVR9) 
-        Sleep(10);
+    m_Game->m_Readiness->AddProbe(Readiness::D3DDevice, [] { return g_D3DVR9 != nullptr; });
+    m_Game->m_Readiness->Wait(Readiness::D3DDevice);
 
     g_D3DVR9->GetBackBufferData(&m_VKBackBuffer);
     m_Overlay = vr::VROverlay();
@@ -111,6 +128,12 @@ VR::VR(Game *game)
         ? vr::TrackingUniverseSeated
         : vr::TrackingUniverseStanding);
 
+    float displayFrequency = m_System->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+    if (displayFrequency > 0)
+        m_DisplayFrequency = displayFrequency;
+    m_SecondsFromVsyncToPhotons = m_System->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
+
+    m_CompositorSync = new CompositorSync([this] { return GetPredictedSecondsToPhotons(); });
     UpdatePosesAndActions();
 
     m_IsInitialized = true;
@@ -229,6 +252,8 @@ void VR::SetScreenSizeOverride(bool bState) {
  */
 void VR::Update()
 {
+    FRAME_TRACE_SCOPE("VR::Update");
+
     if (!m_IsInitialized || !m_Game->m_Initialized)
         return;
 
@@ -252,9 +277,11 @@ void VR::Update()
         } 
     }
 
+    // Frames without a RenderView, like in menus, pick up their poses here
+    BeginFrame();
+
     SubmitVRTextures();
-    UpdatePosesAndActions();
-    UpdateTracking();
+    m_FrameBegun = false;
 
     if (!m_InitialPosReset)
     {
@@ -270,6 +297,25 @@ void VR::Update()
     }
 }
 
+/**
+ * @brief Gets the poses for the frame about to be built.
+ *
+ * Takes the newest poses the compositor thread published, without waiting for it, and updates
+ * tracking from them. Runs once per frame, from RenderView before the eyes are drawn or from
+ * Update for frames that don't render a view.
+ */
+void VR::BeginFrame()
+{
+    if (!m_IsInitialized || m_FrameBegun)
+        return;
+
+    FRAME_TRACE_SCOPE("VR::BeginFrame");
+
+    UpdatePosesAndActions();
+    UpdateTracking();
+    m_FrameBegun = true;
+}
+
 /**
  * @brief Creates the render target textures for VR rendering.
  *
@@ -314,7 +360,7 @@ void VR::CreateVRTextures()
  * @brief Submits the rendered textures to the VR compositor.
  *
  * This function checks if a new frame has been rendered and submits the appropriate textures for
- * the left and right eyes to the VR compositor. It also handles the submission of overlay textures
+ * the left and right eyes, if the compositor started a frame nothing was submitted for yet. It also handles the submission of overlay textures
  * for the main menu when in-game, ensuring proper aspect ratio and bounds. If no new frame is
  * rendered, it falls back to using blank textures.
  *
@@ -322,6 +368,8 @@ void VR::CreateVRTextures()
  */
 void VR::SubmitVRTextures()
 {
+    FRAME_TRACE_SCOPE("VR::SubmitVRTextures");
+
     if (!m_RenderedNewFrame)
     {
         if (!m_BlankTexture)
@@ -354,8 +402,11 @@ void VR::SubmitVRTextures()
 
         //if (!m_Game->m_EngineClient->IsInGame())
         {
-            vr::VRCompositor()->Submit(vr::Eye_Left, &m_VKBlankTexture.m_VRTexture, NULL, vr::Submit_Default);
-            vr::VRCompositor()->Submit(vr::Eye_Right, &m_VKBlankTexture.m_VRTexture, NULL, vr::Submit_Default);
+            FrameSubmission blank;
+            blank.frame = m_PosesFrame;
+            static_cast<vr::Texture_t &>(blank.eyes[vr::Eye_Left]) = m_VKBlankTexture.m_VRTexture;
+            static_cast<vr::Texture_t &>(blank.eyes[vr::Eye_Right]) = m_VKBlankTexture.m_VRTexture;
+            m_CompositorSync->Submit(blank);
         }
 
         return;
@@ -370,8 +421,22 @@ void VR::SubmitVRTextures()
         //vr::VROverlay()->ShowOverlay(m_HUDHandle);
     }
 
-    vr::VRCompositor()->Submit(vr::Eye_Left, &m_VKLeftEye.m_VRTexture, &(m_TextureBounds)[0], vr::Submit_Default);
-    vr::VRCompositor()->Submit(vr::Eye_Right, &m_VKRightEye.m_VRTexture, &(m_TextureBounds)[1], vr::Submit_Default);
+    // With the pose each eye was rendered with the compositor reprojects from where the frame
+    // actually is, not from the pose WaitGetPoses returned
+    FrameSubmission eyes;
+    eyes.frame = m_PosesFrame;
+    static_cast<vr::Texture_t &>(eyes.eyes[vr::Eye_Left]) = m_VKLeftEye.m_VRTexture;
+    static_cast<vr::Texture_t &>(eyes.eyes[vr::Eye_Right]) = m_VKRightEye.m_VRTexture;
+    eyes.bounds[vr::Eye_Left] = m_TextureBounds[0];
+    eyes.bounds[vr::Eye_Right] = m_TextureBounds[1];
+    eyes.hasBounds = true;
+    if (m_HasEyeRenderPoses)
+    {
+        eyes.eyes[vr::Eye_Left].mDeviceToAbsoluteTracking = m_EyeRenderPoses[vr::Eye_Left];
+        eyes.eyes[vr::Eye_Right].mDeviceToAbsoluteTracking = m_EyeRenderPoses[vr::Eye_Right];
+        eyes.flags = vr::Submit_TextureWithPose;
+    }
+    m_CompositorSync->Submit(eyes);
 
     m_RenderedNewFrame = false;
 }
@@ -392,14 +457,10 @@ void VR::GetPoseData(vr::TrackedDevicePose_t &poseRaw, TrackedDevicePoseData &po
         vr::HmdMatrix34_t mat = poseRaw.mDeviceToAbsoluteTracking;
         Vector pos;
         Vector vel;
-        QAngle ang;
         QAngle angvel;
         pos.x = -mat.m[2][3];
         pos.y = -mat.m[0][3];
         pos.z = mat.m[1][3];
-        ang.x = asin(mat.m[1][2]) * (180.0 / 3.141592654);
-        ang.y = atan2f(mat.m[0][2], mat.m[2][2]) * (180.0 / 3.141592654);
-        ang.z = atan2f(-mat.m[1][0], mat.m[1][1]) * (180.0 / 3.141592654);
         vel.x = -poseRaw.vVelocity.v[2];
         vel.y = -poseRaw.vVelocity.v[0];
         vel.z = poseRaw.vVelocity.v[1];
@@ -409,11 +470,38 @@ void VR::GetPoseData(vr::TrackedDevicePose_t &poseRaw, TrackedDevicePoseData &po
 
         poseOut.TrackedDevicePos = pos;
         poseOut.TrackedDeviceVel = vel;
-        poseOut.TrackedDeviceAng = ang;
+        poseOut.TrackedDeviceRot = Rotation::FromTrackingMatrix(mat);
         poseOut.TrackedDeviceAngVel = angvel;
+        poseOut.TrackedDeviceMatrix = mat;
+        poseOut.TrackedDeviceValid = true;
     }
 }
 
+/**
+ * @brief Retrieves pose data for one device from the converted poses of all devices.
+ *
+ * Same as the overload taking a raw pose, except the conversion is already done and only the
+ * rotation is worked out here. Invalid devices and indices leave the pose data unchanged.
+ *
+ * @param poses The converted poses of all tracked devices.
+ * @param device The index of the device.
+ * @param poseOut The structure to be populated with the pose data.
+ */
+void VR::GetPoseData(const TrackedPoses &poses, vr::TrackedDeviceIndex_t device, TrackedDevicePoseData &poseOut)
+{
+    if (!poses.IsValid(device))
+        return;
+
+    poseOut.TrackedDevicePos = Vector(poses.posX[device], poses.posY[device], poses.posZ[device]);
+    poseOut.TrackedDeviceVel = Vector(poses.velX[device], poses.velY[device], poses.velZ[device]);
+    poseOut.TrackedDeviceAngVel.x = poses.angVelX[device];
+    poseOut.TrackedDeviceAngVel.y = poses.angVelY[device];
+    poseOut.TrackedDeviceAngVel.z = poses.angVelZ[device];
+    poseOut.TrackedDeviceMatrix = poses.Matrix(device);
+    poseOut.TrackedDeviceRot = Rotation::FromTrackingMatrix(poseOut.TrackedDeviceMatrix);
+    poseOut.TrackedDeviceValid = true;
+}
+
 /**
  * @brief Repositions VR overlays (e.g., main menu and HUD) based on the HMD's position and orientation.
  *
@@ -499,43 +587,56 @@ void VR::RepositionOverlays()
 /**
  * @brief Updates the pose data for the HMD and controllers.
  * 
- * This function retrieves the current poses of the HMD and controllers (both left and right) and 
- * updates their corresponding pose data structures. The function swaps the controller indices if 
- * the user is left-handed.
- * 
- * TODO: Consider more efficient handling if more tracked devices are added in the future.
+ * This function takes the current poses of the HMD and controllers (both left and right) from the
+ * converted poses of all devices and updates their corresponding pose data structures. The
+ * function swaps the controller indices if the user is left-handed.
  */
 void VR::GetPoses() 
 {
-    vr::TrackedDevicePose_t hmdPose = m_Poses[vr::k_unTrackedDeviceIndex_Hmd];
-
     vr::TrackedDeviceIndex_t leftControllerIndex = m_System->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_LeftHand);
     vr::TrackedDeviceIndex_t rightControllerIndex = m_System->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_RightHand);
 
     if (m_LeftHanded)
         std::swap(leftControllerIndex, rightControllerIndex);
 
-    vr::TrackedDevicePose_t leftControllerPose = m_Poses[leftControllerIndex];
-    vr::TrackedDevicePose_t rightControllerPose = m_Poses[rightControllerIndex];
-
-    GetPoseData(hmdPose, m_HmdPose);
-    GetPoseData(leftControllerPose, m_LeftControllerPose);
-    GetPoseData(rightControllerPose, m_RightControllerPose);
+    GetPoseData(m_TrackedPoses, vr::k_unTrackedDeviceIndex_Hmd, m_HmdPose);
+    GetPoseData(m_TrackedPoses, leftControllerIndex, m_LeftControllerPose);
+    GetPoseData(m_TrackedPoses, rightControllerIndex, m_RightControllerPose);
 }
 
 /**
  * @brief Updates the poses and actions for the VR system.
  *
- * This function synchronizes the pose and action states with the VR system. It retrieves the
- * current device poses using the VR compositor and updates the action states using the VR input
- * interface. This ensures the application has up-to-date information about the tracked devices
- * and their actions.
+ * This function synchronizes the pose and action states with the VR system. It takes the newest
+ * device poses the compositor thread got from WaitGetPoses, without waiting for them, and updates
+ * the action states using the VR input interface. New HMD and hand poses are added to the pose
+ * history. This ensures the application has up-to-date information about the tracked devices and
+ * their actions.
  *
  * TODO: Handle additional tracked devices beyond the max count, if needed.
  */
 void VR::UpdatePosesAndActions() 
 {
-    vr::VRCompositor()->WaitGetPoses(m_Poses, vr::k_unMaxTrackedDeviceCount, NULL, 0);
+    FRAME_TRACE_SCOPE("VR::UpdatePosesAndActions");
+
+    const PoseSnapshot &snapshot = m_CompositorSync->LatestPoses();
+    if (snapshot.frame != m_PosesFrame)
+    {
+        std::copy(std::begin(snapshot.poses), std::end(snapshot.poses), m_Poses);
+        m_TrackedPoses.Convert(m_Poses);
+        m_PosesFrame = snapshot.frame;
+
+        vr::TrackedDeviceIndex_t leftControllerIndex = m_System->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_LeftHand);
+        vr::TrackedDeviceIndex_t rightControllerIndex = m_System->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_RightHand);
+        if (m_LeftHanded)
+            std::swap(leftControllerIndex, rightControllerIndex);
+
+        m_PoseHistory.Push(PoseHistory::Hmd, snapshot.photonTime, m_Poses[vr::k_unTrackedDeviceIndex_Hmd]);
+        if (leftControllerIndex != vr::k_unTrackedDeviceIndexInvalid)
+            m_PoseHistory.Push(PoseHistory::LeftHand, snapshot.photonTime, m_Poses[leftControllerIndex]);
+        if (rightControllerIndex != vr::k_unTrackedDeviceIndexInvalid)
+            m_PoseHistory.Push(PoseHistory::RightHand, snapshot.photonTime, m_Poses[rightControllerIndex]);
+    }
     m_Input->UpdateActionState(&m_ActiveActionSet, sizeof(vr::VRActiveActionSet_t), 1);
 }
 
@@ -766,6 +867,8 @@ void VR::ProcessMenuInput()
  */
 void VR::ProcessInput()
 {
+    FRAME_TRACE_SCOPE("VR::ProcessInput");
+
     if (!m_IsVREnabled)
         return;
 
@@ -1048,37 +1151,23 @@ QAngle& VR::GetRightControllerAbsAngleConst()
 /**
  * @brief Retrieves the absolute position of the right controller.
  *
- * This function calculates the absolute position of the right controller in the game world.
- * If the eye position is not provided, it uses the setup origin. It also considers
- * 6 Degrees of Freedom (6DOF) if enabled.
+ * This function takes the right controller's tracked position into the game world through the
+ * transform chain. If an eye position is provided, it stands in for the setup origin. Without
+ * 6 Degrees of Freedom (6DOF) the chain keeps the controller relative to the HMD.
  *
  * @param eyePosition The position of the player's eye.
  * @return The absolute position of the right controller.
  *
  * TODO: Handle player entity retrieval and eye position more reliably.
- * TODO: Ensure the correct calculation of positions related to 6DOF and HMD-relative positions.
  */
 Vector VR::GetRightControllerAbsPos(Vector eyePosition)
 {
-    Vector offset = eyePosition;
+    Vector controllerPosLocal = m_RightControllerPose.TrackedDevicePos;
 
-    if (offset.x == 0 && offset.y == 0 && offset.z == 0) {
-        /*int playerIndex = m_Game->m_EngineClient->GetLocalPlayer();
-        C_BasePlayer* localPlayer = (C_BasePlayer*)m_Game->GetClientEntity(playerIndex);
-        if (!localPlayer)
-            return {0, 0, 0};
+    if (eyePosition.x == 0 && eyePosition.y == 0 && eyePosition.z == 0)
+        return m_Transforms.Point(TransformChain::World, controllerPosLocal);
 
-        offset = localPlayer->EyePosition();*/
-
-        offset = m_SetupOrigin;
-    }
-
-    Vector position = offset + m_RightControllerPosRel;
-
-    if (m_6DOF)
-        position += m_HmdPosRelative;
-
-    return position;
+    return eyePosition + m_Transforms.Point(TransformChain::Player, controllerPosLocal);
 }
 
 /**
@@ -1105,46 +1194,145 @@ Vector VR::GetRecommendedViewmodelAbsPos(Vector eyePosition)
 /**
  * @brief Calculates the recommended absolute angle for the viewmodel.
  *
- * This function converts the viewmodel's forward and up vectors into angles and returns
- * the recommended absolute angle for the viewmodel.
+ * This function converts the viewmodel's rotation into angles and returns the recommended
+ * absolute angle for the viewmodel.
  *
  * @return The recommended absolute angle for the viewmodel.
- *
- * TODO: Ensure the correct transformation from vectors to angles.
  */
 QAngle VR::GetRecommendedViewmodelAbsAngle()
 {
-    QAngle result{};
+    return m_ViewmodelRotation.ToAngles();
+}
+
+/**
+ * @brief Updates the HMD angles based on the current rotation offset.
+ *
+ * This function rotates the tracked HMD orientation by the current rotation offset and
+ * recalculates the forward, right, and up vectors and the angles for the HMD's orientation.
+ * The transform chain is brought up to date too, since the offset or the HMD may have changed.
+ */
+void VR::UpdateHMDAngles() {
+    UpdateTransforms();
 
-    QAngle::VectorAngles(m_ViewmodelForward, m_ViewmodelUp, result);
+    m_HmdRotation = GetHmdRotation(m_HmdPose.TrackedDeviceRot);
+    m_HmdRotation.Axes(&m_HmdForward, &m_HmdRight, &m_HmdUp);
 
-    return result;
+    m_HmdAngAbs = m_HmdRotation.ToAngles();
+    m_HmdAngAbs.Normalize();
 }
 
 /**
- * @brief Updates the HMD angles based on the current rotation offset.
+ * @brief Applies the rotation offset to a tracked HMD orientation.
  *
- * This function adjusts the local angles of the HMD by adding the current rotation
- * offset and recalculating the forward, right, and up vectors for the HMD's orientation.
+ * @param hmdRotLocal The HMD orientation in tracking space.
+ * @return Rotation The HMD orientation in the game.
+ */
+Rotation VR::GetHmdRotation(const Rotation &hmdRotLocal)
+{
+    return Rotation::FromAngles(m_RotationOffset) * hmdRotLocal;
+}
+
+/**
+ * @brief Brings the transform chain from tracking space to the world up to date.
  *
- * TODO: Ensure accurate HMD orientation calculations especially after normalization.
+ * Tracked positions are taken around the play area's center, scaled to game units, turned by
+ * the rotation offset's yaw and moved to the setup origin. Without 6DOF the play area is
+ * centered on the HMD instead, so the view stays at the setup origin and the hands move with
+ * it. Links that didn't change keep their composed transforms.
  */
-void VR::UpdateHMDAngles() {
-    QAngle hmdAngLocal = m_HmdPose.TrackedDeviceAng;
+void VR::UpdateTransforms()
+{
+    m_Transforms.SetAnchor(m_6DOF ? m_Center : m_HmdPose.TrackedDevicePos, m_VRScale);
+    m_Transforms.SetYaw(m_RotationOffset.y);
+    m_Transforms.SetOrigin(m_SetupOrigin);
+}
 
-    //hmdAngLocal += m_RotationOffset;
-    hmdAngLocal.x += m_RotationOffset.x;
-    hmdAngLocal.y += m_RotationOffset.y;
-    hmdAngLocal.z += m_RotationOffset.z;
+/**
+ * @brief Gets the orientation a controller aims with.
+ *
+ * @param controllerRot The controller orientation.
+ * @return Rotation The orientation tilted down to simulate natural controller orientation.
+ */
+Rotation VR::GetControllerRotation(const Rotation &controllerRot)
+{
+    static const Rotation tilt = Rotation::FromAngles(QAngle(30, 0, 0));
+    return controllerRot * tilt;
+}
 
-    //hmdAngLocal.Normalize();
+/**
+ * @brief Resamples the HMD and right controller poses for the usercmd being created.
+ *
+ * UpdateTracking runs once per compositor frame, usercmds are created at the game's tick rate.
+ * This predicts the poses to now and runs them through the same transforms as UpdateTracking, so
+ * the view angles and the hand sent with a usercmd are where they are when it's created.
+ *
+ * @return bool False if the poses aren't valid, usercmds then use the poses from UpdateTracking.
+ */
+bool VR::ResampleInputPose()
+{
+    FRAME_TRACE_SCOPE("VR::ResampleInputPose");
+
+    m_InputPose.Valid = false;
+
+    vr::TrackedDeviceIndex_t controllerIndex = m_System->GetTrackedDeviceIndexForControllerRole(
+        m_LeftHanded ? vr::TrackedControllerRole_LeftHand : vr::TrackedControllerRole_RightHand);
+    if (controllerIndex == vr::k_unTrackedDeviceIndexInvalid || !m_HmdPose.TrackedDeviceValid)
+        return false;
+
+    vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
+    m_System->GetDeviceToAbsoluteTrackingPose(vr::VRCompositor()->GetTrackingSpace(), 0, poses, controllerIndex + 1);
+
+    // Bridges tracking dropping out for a moment
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!poses[vr::k_unTrackedDeviceIndex_Hmd].bPoseIsValid)
+        m_PoseHistory.PoseAt(PoseHistory::Hmd, now, poses[vr::k_unTrackedDeviceIndex_Hmd]);
+    if (!poses[controllerIndex].bPoseIsValid)
+        m_PoseHistory.PoseAt(PoseHistory::RightHand, now, poses[controllerIndex]);
+
+    if (!poses[vr::k_unTrackedDeviceIndex_Hmd].bPoseIsValid || !poses[controllerIndex].bPoseIsValid)
+        return false;
+
+    TrackedDevicePoseData hmdPose;
+    TrackedDevicePoseData controllerPose;
+    GetPoseData(poses[vr::k_unTrackedDeviceIndex_Hmd], hmdPose);
+    GetPoseData(poses[controllerIndex], controllerPose);
+
+    m_InputPose.HmdPosRelative = m_Transforms.Point(TransformChain::Player, hmdPose.TrackedDevicePos);
+
+    m_InputPose.HmdAngAbs = GetHmdRotation(hmdPose.TrackedDeviceRot).ToAngles();
+    m_InputPose.HmdAngAbs.Normalize();
+
+    m_InputPose.RightControllerPos = controllerPose.TrackedDevicePos;
 
-    QAngle::AngleVectors(hmdAngLocal, &m_HmdForward, &m_HmdRight, &m_HmdUp);
+    Rotation controllerRotation = GetControllerRotation(Rotation::FromAngles(m_RotationOffset) * controllerPose.TrackedDeviceRot);
+    m_InputPose.RightControllerAngAbs = controllerRotation.ToAngles();
+    m_InputPose.RightControllerAngAbs.Normalize();
 
-    //hmdAngLocal.x = (hmdAngLocal.x > 180 ? 180)
-    hmdAngLocal.Normalize();
+    m_InputPose.Valid = true;
+    return true;
+}
+
+/**
+ * @brief Gets the absolute position of the right controller for the usercmd being created.
+ *
+ * Same as GetRightControllerAbsPos, from the pose ResampleInputPose took if there is one.
+ */
+Vector VR::GetInputRightControllerAbsPos()
+{
+    if (!m_InputPose.Valid)
+        return GetRightControllerAbsPos();
 
-    m_HmdAngAbs = hmdAngLocal;
+    return m_Transforms.Point(TransformChain::World, m_InputPose.RightControllerPos);
+}
+
+/**
+ * @brief Gets the absolute angles of the right controller for the usercmd being created.
+ *
+ * Same as GetRightControllerAbsAngle, from the pose ResampleInputPose took if there is one.
+ */
+QAngle VR::GetInputRightControllerAbsAngle()
+{
+    return m_InputPose.Valid ? m_InputPose.RightControllerAngAbs : m_RightControllerAngAbs;
 }
 
 void VR::ResetPosition()
@@ -1152,6 +1340,8 @@ void VR::ResetPosition()
     m_Center = m_HmdPose.TrackedDevicePos;
     if (!m_SeatedMode)
         m_Center.z = 0;
+
+    UpdateTransforms();
 }
 
 /**
@@ -1165,6 +1355,8 @@ void VR::ResetPosition()
  */
 void VR::UpdateTracking()
 {
+    FRAME_TRACE_SCOPE("VR::UpdateTracking");
+
     // Retrieve the current tracking poses for the HMD and controllers
     GetPoses();
 
@@ -1178,22 +1370,15 @@ void VR::UpdateTracking()
 
     // HMD tracking
     Vector hmdPosLocal = m_HmdPose.TrackedDevicePos;
-    Vector hmdPosCentered = hmdPosLocal - m_Center;
 
-    m_HmdPosRelativeRaw = hmdPosCentered;
+    m_HmdPosRelativeRaw = hmdPosLocal - m_Center;
 
     //std::cout << "HMD - X: " << hmdWorldPos.x << ", Y: " << hmdWorldPos.y << ", Z: " << hmdWorldPos.z << "\n";
 
-    Vector hmdPosCorrected = hmdPosCentered;
-    VectorPivotXY(hmdPosCorrected, { 0, 0, 0 }, m_RotationOffset.y);
-    
     UpdateHMDAngles();
 
-    m_HmdPosRelative = hmdPosCorrected * m_VRScale;
-    if (!m_SeatedMode)
-        // 64 is the eye view height from the player's base position
-        // we subtract this here so that we place the HMD height at the actual player height if 6DOF is enabled
-        m_HmdPosRelative.z -= 64;
+    // HMD position relative to the setup origin, in game units with the rotation offset applied
+    m_HmdPosRelative = m_Transforms.Point(TransformChain::Player, hmdPosLocal);
 
     // Roomscale setup
     /*Vector cameraMovingDirection = m_Center - m_SetupOriginPrev;
@@ -1210,15 +1395,6 @@ void VR::UpdateTracking()
     if ((cameraFollowing < 0 && cameraDistance > 1) || (m_PushingThumbstick))
         m_RoomscaleActive = false;*/
 
-    // Apply rotation offset to HMD position
-    Vector hmdPosCorrected = hmdPosCentered;
-    VectorPivotXY(hmdPosCorrected, { 0, 0, 0 }, m_RotationOffset.y);
-
-    UpdateHMDAngles();
-
-    // Scale HMD position for VR space
-    m_HmdPosRelative = hmdPosCorrected * m_VRScale;
-
     // Calculate aiming position
     m_AimPos = Trace((uint32_t*)localPlayer);
 
@@ -1277,39 +1453,17 @@ void VR::UpdateTracking()
     m_Ipd = m_EyeToHeadTransformPosRight.x * 2;
     m_EyeZ = m_EyeToHeadTransformPosRight.z;
 
-    // Hand tracking
-    Vector leftControllerPosLocal = m_LeftControllerPose.TrackedDevicePos;
-    QAngle leftControllerAngLocal = m_LeftControllerPose.TrackedDeviceAng;
-
-    Vector rightControllerPosLocal = m_RightControllerPose.TrackedDevicePos;
-    QAngle rightControllerAngLocal = m_RightControllerPose.TrackedDeviceAng;
-
-    // Calculate right controller's relative position and orientation
-    Vector hmdToController = rightControllerPosLocal - hmdPosLocal;
-
-    // Apply rotation offset to controller positions
-    VectorPivotXY(hmdToController, { 0, 0, 0 }, m_RotationOffset.y);
-    m_RightControllerPosRel = hmdToController * m_VRScale;
-
-    rightControllerAngLocal.x += m_RotationOffset.x;
-    rightControllerAngLocal.y += m_RotationOffset.y;
-    rightControllerAngLocal.z += m_RotationOffset.z;
+    // Hand tracking, positions are taken through m_Transforms when asked for
+    m_LeftControllerRotation = GetControllerRotation(m_LeftControllerPose.TrackedDeviceRot);
+    m_RightControllerRotation = GetControllerRotation(Rotation::FromAngles(m_RotationOffset) * m_RightControllerPose.TrackedDeviceRot);
 
     // Update controller orientation vectors
-    QAngle::AngleVectors(leftControllerAngLocal, &m_LeftControllerForward, &m_LeftControllerRight, &m_LeftControllerUp);
-    QAngle::AngleVectors(rightControllerAngLocal, &m_RightControllerForward, &m_RightControllerRight, &m_RightControllerUp);
-
-    // Apply downward angle offset to simulate natural controller orientation
-    const float offset = -30;
-    m_LeftControllerForward = VectorRotate(m_LeftControllerForward, m_LeftControllerRight, offset);
-    m_LeftControllerUp = VectorRotate(m_LeftControllerUp, m_LeftControllerRight, offset);
-
-    m_RightControllerForward = VectorRotate(m_RightControllerForward, m_RightControllerRight, offset);
-    m_RightControllerUp = VectorRotate(m_RightControllerUp, m_RightControllerRight, offset);
+    m_LeftControllerRotation.Axes(&m_LeftControllerForward, &m_LeftControllerRight, &m_LeftControllerUp);
+    m_RightControllerRotation.Axes(&m_RightControllerForward, &m_RightControllerRight, &m_RightControllerUp);
 
     // Calculate final absolute angle for controllers
-    QAngle::VectorAngles(m_LeftControllerForward, m_LeftControllerUp, m_LeftControllerAngAbs);
-    QAngle::VectorAngles(m_RightControllerForward, m_RightControllerUp, m_RightControllerAngAbs);
+    m_LeftControllerAngAbs = m_LeftControllerRotation.ToAngles();
+    m_RightControllerAngAbs = m_RightControllerRotation.ToAngles();
     m_RightControllerAngAbs.Normalize();
 
     // Configure viewmodel position and orientation
@@ -1317,213 +1471,180 @@ void VR::UpdateTracking()
     m_ViewmodelPosOffset = viewmodelOffset.position + m_ViewmodelPosCustomOffset;
     m_ViewmodelAngOffset = viewmodelOffset.angle + m_ViewmodelAngCustomOffset;
 
-    m_ViewmodelForward = m_RightControllerForward;
-    m_ViewmodelUp = m_RightControllerUp;
-    m_ViewmodelRight = m_RightControllerRight;
-
-    // Apply viewmodel yaw, pitch, and roll offsets
-    m_ViewmodelForward = VectorRotate(m_ViewmodelForward, m_ViewmodelUp, m_ViewmodelAngOffset.y);
-    m_ViewmodelRight = VectorRotate(m_ViewmodelRight, m_ViewmodelUp, m_ViewmodelAngOffset.y);
-
-    m_ViewmodelForward = VectorRotate(m_ViewmodelForward, m_ViewmodelRight, m_ViewmodelAngOffset.x);
-    m_ViewmodelUp = VectorRotate(m_ViewmodelUp, m_ViewmodelRight, m_ViewmodelAngOffset.x);
-
-    m_ViewmodelRight = VectorRotate(m_ViewmodelRight, m_ViewmodelForward, m_ViewmodelAngOffset.z);
-    m_ViewmodelUp = VectorRotate(m_ViewmodelUp, m_ViewmodelForward, m_ViewmodelAngOffset.z);
-
-}
+    // Apply viewmodel yaw, pitch, and roll offsets around the controller's own axes, a positive
+    // pitch offset tilts the viewmodel up
+    QAngle viewmodelAngOffset(-m_ViewmodelAngOffset.x, m_ViewmodelAngOffset.y, m_ViewmodelAngOffset.z);
+    m_ViewmodelRotation = m_RightControllerRotation * Rotation::FromAngles(viewmodelAngOffset);
+    m_ViewmodelRotation.Axes(&m_ViewmodelForward, &m_ViewmodelRight, &m_ViewmodelUp);
 
-Vector VR::GetViewAngle()
-{
-    return Vector( m_HmdAngAbs.x, m_HmdAngAbs.y, m_HmdAngAbs.z );
 }
 
-Vector VR::GetViewOrigin(Vector setupOrigin)
-{
-    Vector center = setupOrigin;
-
-    if (m_6DOF)
-        center += m_HmdPosRelative;
-
-    return center + (m_HmdForward * -(m_EyeZ * m_VRScale));
-}
-
-Vector VR::GetViewOriginLeft(Vector setupOrigin)
+/**
+ * @brief Predicts how long until the frame being rendered now is shown on the display.
+ *
+ * The frame goes out on the vsync after the current one, then takes the display's vsync to
+ * photons delay to light up.
+ *
+ * @return float Seconds from now until the photons.
+ */
+float VR::GetPredictedSecondsToPhotons()
 {
-    Vector viewOriginLeft = GetViewOrigin(setupOrigin);
-    viewOriginLeft -= m_HmdRight * ((m_Ipd * m_IpdScale * m_VRScale) / 2);
+    float secondsSinceLastVsync = 0;
+    uint64_t frameCounter = 0;
+    m_System->GetTimeSinceLastVsync(&secondsSinceLastVsync, &frameCounter);
 
-    return viewOriginLeft;
+    return 1.0f / m_DisplayFrequency - secondsSinceLastVsync + m_SecondsFromVsyncToPhotons;
 }
 
-Vector VR::GetViewOriginRight(Vector setupOrigin)
+/**
+ * @brief Gets the view an eye is rendered from, with the HMD pose re-predicted right before it's drawn.
+ *
+ * UpdateTracking uses the poses WaitGetPoses returned at the start of the compositor frame, which
+ * can be most of a frame old by the time the eyes are drawn. This takes the pose for when this
+ * frame reaches the display, queried from the runtime when late latching or else from the pose
+ * history, and places the eye with it the same way UpdateTracking places the HMD. The frame's HMD
+ * pose the game uses is left as it is, so each eye starts from it and game code after RenderView
+ * doesn't see render only poses. The pose the eye is rendered with is kept for SubmitVRTextures.
+ *
+ * @param eye The eye about to be rendered.
+ * @return EyeViewData The eye's origin and orientation in the game.
+ */
+EyeViewData VR::LateLatchHmdPose(vr::EVREye eye)
 {
-    Vector viewOriginRight = GetViewOrigin(setupOrigin);
-    viewOriginRight += m_HmdRight * ((m_Ipd * m_IpdScale * m_VRScale) / 2);
+    FRAME_TRACE_SCOPE("VR::LateLatchHmdPose");
 
-    return viewOriginRight;
-}
+    if (!m_LogLatency && m_LatencyLog.is_open())
+    {
+        m_LatencyLog.close();
+        std::cout << "Wrote latency log to " << LatencyLogPath << "\n";
+    }
 
-Vector VR::Trace(uint32_t* localPlayer) {
-    Vector vecStart = GetRightControllerAbsPos();
-    Vector vecEnd = vecStart + m_RightControllerForward * MAX_TRACE_LENGTH;
+    float predictedSeconds = GetPredictedSecondsToPhotons();
+    std::chrono::steady_clock::time_point photonTime = std::chrono::steady_clock::now()
+        + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(predictedSeconds));
 
-    CGameTrace trace;
-    Ray_t ray;
-    CTraceFilterSkipNPCsAndPlayers tracefilter((IHandleEntity*)localPlayer, 0);
+    vr::TrackedDevicePose_t hmdPose = {};
+    bool lateLatched = false;
+    if (m_LateLatch)
+    {
+        m_System->GetDeviceToAbsoluteTrackingPose(vr::VRCompositor()->GetTrackingSpace(), predictedSeconds, &hmdPose, 1);
+        lateLatched = hmdPose.bPoseIsValid;
+    }
+    if (!lateLatched)
+        m_PoseHistory.PoseAt(PoseHistory::Hmd, photonTime, hmdPose);
 
-    ray.Init(vecStart, vecEnd);
+    TrackedDevicePoseData eyePose = m_HmdPose;
+    if (hmdPose.bPoseIsValid)
+        GetPoseData(hmdPose, eyePose);
 
-    m_Game->m_EngineTrace->TraceRay(ray, MASK_SHOT | MASK_SHOT_HULL, &tracefilter, &trace);
+    if (m_LogLatency)
+    {
+        // A late latched pose is the runtime's own prediction, a history pose is extrapolated past the newest sample
+        float extrapolatedMs = 0;
+        std::chrono::steady_clock::time_point newestTime;
+        if (!lateLatched && hmdPose.bPoseIsValid && m_PoseHistory.NewestTime(PoseHistory::Hmd, newestTime))
+            extrapolatedMs = std::chrono::duration<float, std::milli>(photonTime - newestTime).count();
+
+        const char *source = lateLatched ? "late latched" : hmdPose.bPoseIsValid ? "history" : "none";
+        LogLatency(eye, source, predictedSeconds * 1000, extrapolatedMs);
+    }
 
-    return trace.endpos;
-}
+    // Whatever pose this eye ends up rendered with goes to the compositor with its texture
+    if (eyePose.TrackedDeviceValid)
+    {
+        m_EyeRenderPoses[eye] = eyePose.TrackedDeviceMatrix;
+        m_HasEyeRenderPoses = true;
+    }
 
-void AngleMatrix(const QAngle& angles, matrix3x4_t& matrix)
-{
-    float sr, sp, sy, cr, cp, cy;
-
-    SinCos(DEG2RAD(angles[YAW]), &sy, &cy);
-    SinCos(DEG2RAD(angles[PITCH]), &sp, &cp);
-    SinCos(DEG2RAD(angles[ROLL]), &sr, &cr);
-
-    // matrix = (YAW * PITCH) * ROLL
-    matrix[0][0] = cp * cy;
-    matrix[1][0] = cp * sy;
-    matrix[2][0] = -sp;
-
-    // NOTE: Do not optimize this to reduce multiplies! optimizer bug will screw this up.
-    matrix[0][1] = sr * sp * cy + cr * -sy;
-    matrix[1][1] = sr * sp * sy + cr * cy;
-    matrix[2][1] = sr * cp;
-    matrix[0][2] = (cr * sp * cy + -sr * -sy);
-    matrix[1][2] = (cr * sp * sy + -sr * cy);
-    matrix[2][2] = cr * cp;
-
-    matrix[0][3] = 0.0f;
-    matrix[1][3] = 0.0f;
-    matrix[2][3] = 0.0f;
+    EyeViewData view;
+    view.EyeRotation = GetHmdRotation(eyePose.TrackedDeviceRot);
+    view.Angles = view.EyeRotation.ToAngles();
+    view.Angles.Normalize();
+    // Without 6DOF the view stays on the setup origin, only the orientation follows the new pose
+    view.Origin = GetViewOrigin(m_6DOF ? eyePose.TrackedDevicePos : m_HmdPose.TrackedDevicePos, view.EyeRotation, eye);
+    return view;
 }
 
-void MatrixCopy(const matrix3x4_t& in, matrix3x4_t& out)
+/**
+ * @brief Appends a row to the latency log for the eye about to be rendered.
+ *
+ * Extrapolated is how far past the newest pose in the pose history the rendered HMD pose was
+ * predicted, which is what prediction errors grow with, negative when it was interpolated between
+ * samples. Stale submits counts frames submitted with poses from before the previous compositor
+ * frame, unsubmitted frames the ones rendered while the compositor had no frame for them. The frame
+ * timing columns are the compositor's numbers for its most recent frame.
+ *
+ * @param eye The eye about to be rendered.
+ * @param source Where the rendered HMD pose came from: late latched, history or none.
+ * @param predictedMs Predicted time until this frame is shown.
+ * @param extrapolatedMs Time the history pose was extrapolated past its newest sample, 0 if it wasn't from the history.
+ */
+void VR::LogLatency(vr::EVREye eye, const char *source, float predictedMs, float extrapolatedMs)
 {
-    memcpy(out.Base(), in.Base(), sizeof(float) * 3 * 4);
-}
+    if (!m_LatencyLog.is_open())
+    {
+        m_LatencyLog.open(LatencyLogPath);
+        m_LatencyLog << "frame,eye,pose source,predicted ms,extrapolated ms,stale submits,unsubmitted frames,dropped frames,mispresented,reprojection flags,gpu ms\n";
+    }
 
+    vr::Compositor_FrameTiming timing = {};
+    timing.m_nSize = sizeof(vr::Compositor_FrameTiming);
+    vr::VRCompositor()->GetFrameTiming(&timing, 0);
 
-/*
-================
-R_ConcatTransforms
-================
-*/
+    m_LatencyLog << m_PosesFrame << "," << (eye == vr::Eye_Left ? "left" : "right") << "," << source << ","
+        << predictedMs << "," << extrapolatedMs << "," << m_CompositorSync->StaleSubmits() << "," << m_CompositorSync->DroppedFrames() << ","
+        << timing.m_nNumDroppedFrames << "," << timing.m_nNumMisPresented << "," << timing.m_nReprojectionFlags << ","
+        << timing.m_flTotalRenderGpuMs << "\n";
+}
 
-void ConcatTransforms(const matrix3x4_t& in1, const matrix3x4_t& in2, matrix3x4_t& out)
+Vector VR::GetViewAngle()
 {
-    if (&in1 == &out)
-    {
-        matrix3x4_t in1b;
-        MatrixCopy(in1, in1b);
-        ConcatTransforms(in1b, in2, out);
-        return;
-    }
-    if (&in2 == &out)
-    {
-        matrix3x4_t in2b;
-        MatrixCopy(in2, in2b);
-        ConcatTransforms(in1, in2b, out);
-        return;
-    }
-    out[0][0] = in1[0][0] * in2[0][0] + in1[0][1] * in2[1][0] +
-        in1[0][2] * in2[2][0];
-    out[0][1] = in1[0][0] * in2[0][1] + in1[0][1] * in2[1][1] +
-        in1[0][2] * in2[2][1];
-    out[0][2] = in1[0][0] * in2[0][2] + in1[0][1] * in2[1][2] +
-        in1[0][2] * in2[2][2];
-    out[0][3] = in1[0][0] * in2[0][3] + in1[0][1] * in2[1][3] +
-        in1[0][2] * in2[2][3] + in1[0][3];
-    out[1][0] = in1[1][0] * in2[0][0] + in1[1][1] * in2[1][0] +
-        in1[1][2] * in2[2][0];
-    out[1][1] = in1[1][0] * in2[0][1] + in1[1][1] * in2[1][1] +
-        in1[1][2] * in2[2][1];
-    out[1][2] = in1[1][0] * in2[0][2] + in1[1][1] * in2[1][2] +
-        in1[1][2] * in2[2][2];
-    out[1][3] = in1[1][0] * in2[0][3] + in1[1][1] * in2[1][3] +
-        in1[1][2] * in2[2][3] + in1[1][3];
-    out[2][0] = in1[2][0] * in2[0][0] + in1[2][1] * in2[1][0] +
-        in1[2][2] * in2[2][0];
-    out[2][1] = in1[2][0] * in2[0][1] + in1[2][1] * in2[1][1] +
-        in1[2][2] * in2[2][1];
-    out[2][2] = in1[2][0] * in2[0][2] + in1[2][1] * in2[1][2] +
-        in1[2][2] * in2[2][2];
-    out[2][3] = in1[2][0] * in2[0][3] + in1[2][1] * in2[1][3] +
-        in1[2][2] * in2[2][3] + in1[2][3];
+    return Vector( m_HmdAngAbs.x, m_HmdAngAbs.y, m_HmdAngAbs.z );
 }
 
-void MatrixAngles(const matrix3x4_t& matrix, float* angles)
+/**
+ * @brief Gets where an eye is in the game for an HMD pose.
+ *
+ * @param hmdPos The HMD position in tracking space.
+ * @param hmdRotation The HMD orientation in the game.
+ * @param eye The eye to place.
+ * @return Vector The eye's origin in the game.
+ */
+Vector VR::GetViewOrigin(const Vector &hmdPos, const Rotation &hmdRotation, vr::EVREye eye)
 {
-    float forward[3];
-    float left[3];
-    float up[3];
-
-    //
-    // Extract the basis vectors from the matrix. Since we only need the Z
-    // component of the up vector, we don't get X and Y.
-    //
-    forward[0] = matrix[0][0];
-    forward[1] = matrix[1][0];
-    forward[2] = matrix[2][0];
-    left[0] = matrix[0][1];
-    left[1] = matrix[1][1];
-    left[2] = matrix[2][1];
-    up[2] = matrix[2][2];
-
-    float xyDist = sqrtf(forward[0] * forward[0] + forward[1] * forward[1]);
-
-    // enough here to get angles?
-    if (xyDist > 0.001f)
-    {
-        // (yaw)	y = ATAN( forward.y, forward.x );		-- in our space, forward is the X axis
-        angles[1] = RAD2DEG(atan2f(forward[1], forward[0]));
-
-        // (pitch)	x = ATAN( -forward.z, sqrt(forward.x*forward.x+forward.y*forward.y) );
-        angles[0] = RAD2DEG(atan2f(-forward[2], xyDist));
+    Vector forward, right, up;
+    hmdRotation.Axes(&forward, &right, &up);
 
-        // (roll)	z = ATAN( left.z, up.z );
-        angles[2] = RAD2DEG(atan2f(left[2], up[2]));
-    }
-    else	// forward is mostly Z, gimbal lock-
-    {
-        // (yaw)	y = ATAN( -left.x, left.y );			-- forward is mostly z, so use right for yaw
-        angles[1] = RAD2DEG(atan2f(-left[0], left[1]));
+    Vector center = m_Transforms.Point(TransformChain::World, hmdPos);
+    Vector viewOrigin = center + (forward * -(m_EyeZ * m_VRScale));
 
-        // (pitch)	x = ATAN( -forward.z, sqrt(forward.x*forward.x+forward.y*forward.y) );
-        angles[0] = RAD2DEG(atan2f(-forward[2], xyDist));
+    float halfIpd = (m_Ipd * m_IpdScale * m_VRScale) / 2;
+    if (eye == vr::Eye_Left)
+        viewOrigin -= right * halfIpd;
+    else
+        viewOrigin += right * halfIpd;
 
-        // Assume no roll in this case as one degree of freedom has been lost (i.e. yaw == roll)
-        angles[2] = 0;
-    }
+    return viewOrigin;
 }
 
-inline void MatrixAngles(const matrix3x4_t& matrix, QAngle& angles)
-{
-    MatrixAngles(matrix, &angles.x);
-}
+Vector VR::Trace(uint32_t* localPlayer) {
+    Vector vecStart = GetRightControllerAbsPos();
+    Vector vecEnd = vecStart + m_RightControllerForward * MAX_TRACE_LENGTH;
+
+    CGameTrace trace;
+    Ray_t ray;
+    CTraceFilterSkipNPCsAndPlayers tracefilter((IHandleEntity*)localPlayer, 0);
 
+    ray.Init(vecStart, vecEnd);
 
+    m_Game->m_EngineTrace->TraceRay(ray, MASK_SHOT | MASK_SHOT_HULL, &tracefilter, &trace);
 
-// transform a set of angles in the input space of parentMatrix to the output space
-QAngle TransformAnglesToWorldSpace(const QAngle& angles, const matrix3x4_t& parentMatrix)
-{
-    matrix3x4_t angToParent, angToWorld;
-    AngleMatrix(angles, angToParent);
-    ConcatTransforms(parentMatrix, angToParent, angToWorld);
-    QAngle out;
-    MatrixAngles(angToWorld, out);
-    return out;
+    return trace.endpos;
 }
 
+Vector VR::TraceEye(uint32_t* localPlayer, Vector cameraPos, Vector eyePos, Rotation& eyeRotation) {
+    FRAME_TRACE_SCOPE("VR::TraceEye");
 
-Vector VR::TraceEye(uint32_t* localPlayer, Vector cameraPos, Vector eyePos, QAngle& eyeAngle) {
     CGameTrace trTestObstructionsNearPortals;
     Ray_t ray;
     CTraceFilterSkipNPCsAndPlayers tracefilter((IHandleEntity*)localPlayer, 0);
@@ -1546,7 +1667,7 @@ Vector VR::TraceEye(uint32_t* localPlayer, Vector cameraPos, Vector eyePos, QAng
    
         /*QAngle newAngle;
         m_Game->m_Hooks->UTIL_Portal_AngleTransform(matrix, eyeAngle, newAngle);*/
-        eyeAngle = TransformAnglesToWorldSpace(eyeAngle, matrix.As3x4());
+        eyeRotation = Rotation::FromMatrix(matrix.As3x4()) * eyeRotation;
 
         return matrix * vHitPoint;
 
@@ -1678,6 +1799,23 @@ void VR::ParseConfigFile()
     parseOrDefault("PortallingDetectionDistanceThreshold", m_PortallingDetectionDistanceThreshold, 35);
     parseOrDefault("ApplyPitchAndRollPortalRotationOffset", m_ApplyPitchAndRollPortalRotationOffset, false);
     parseOrDefault("CameraUprightRecoverySpeed", m_CameraUprightRecoverySpeed, 0.2f);
+
+    parseOrDefault("LateLatch", m_LateLatch, true);
+    parseOrDefault("LogLatency", m_LogLatency, false);
+    parseOrDefault("LogHookStats", m_LogHookStats, false);
+    HOOK_STATS_LOG_FRAMES(m_LogHookStats);
+
+    // Switching it off again writes what was recorded
+    bool wasTracing = m_TraceFrames;
+    parseOrDefault("TraceFrames", m_TraceFrames, false);
+    FrameTrace::Recorder::Get().SetEnabled(m_TraceFrames);
+    if (wasTracing && !m_TraceFrames)
+    {
+        if (FrameTrace::Recorder::Get().Export(FrameTracePath))
+            std::cout << "Wrote frame trace to " << FrameTracePath << "\n";
+        else
+            Game::errorMsg("Failed to write the frame trace");
+    }
 }
 
 void VR::WaitForConfigUpdate()
@@ -1,11 +1,17 @@
 #pragma once
 #include "openvr.h"
 #include "vector.h"
+#include "posehistory.h"
+#include "trackedposes.h"
+#include "rotation.h"
+#include "transforms.h"
 #include <chrono>
+#include <fstream>
 
 #define MAX_STR_LEN 256
 
 class Game;
+class CompositorSync;
 class IDirect3DTexture9;
 class IDirect3DSurface9;
 class ITexture;
@@ -16,8 +22,30 @@ struct TrackedDevicePoseData
 	std::string TrackedDeviceName;
 	Vector TrackedDevicePos;
 	Vector TrackedDeviceVel;
-	QAngle TrackedDeviceAng;
+	Rotation TrackedDeviceRot;
 	QAngle TrackedDeviceAngVel;
+	// The raw device to absolute tracking matrix the above were taken from
+	vr::HmdMatrix34_t TrackedDeviceMatrix = {};
+	bool TrackedDeviceValid = false;
+};
+
+// HMD and right controller poses resampled for a usercmd, see VR::ResampleInputPose
+struct InputPoseData
+{
+	QAngle HmdAngAbs;
+	Vector HmdPosRelative;
+	// Tracking space, goes through m_Transforms like m_RightControllerPose
+	Vector RightControllerPos;
+	QAngle RightControllerAngAbs;
+	bool Valid = false;
+};
+
+// Where an eye is rendered from, see VR::LateLatchHmdPose
+struct EyeViewData
+{
+	Vector Origin;
+	Rotation EyeRotation;
+	QAngle Angles;
 };
 
 struct SharedTextureHolder 
@@ -52,10 +80,30 @@ public:
 
 	vr::VRTextureBounds_t m_TextureBounds[2];
 	vr::TrackedDevicePose_t m_Poses[vr::k_unMaxTrackedDeviceCount];
+	// m_Poses converted to Source's axes
+	TrackedPoses m_TrackedPoses;
+	// Compositor frame m_Poses are from
+	uint64_t m_PosesFrame = 0;
+	CompositorSync *m_CompositorSync = nullptr;
+	// HMD and hand poses of the last compositor frames, the hands follow m_LeftHanded like m_RightControllerPose
+	PoseHistory::Store m_PoseHistory;
+	// HMD display timing, for predicting when a frame reaches the display
+	float m_DisplayFrequency = 90.0;
+	float m_SecondsFromVsyncToPhotons = 0.0;
+	std::ofstream m_LatencyLog;
+	// HMD pose each eye was rendered with, submitted along with its texture
+	vr::HmdMatrix34_t m_EyeRenderPoses[2] = {};
+	bool m_HasEyeRenderPoses = false;
 
 	Vector m_EyeToHeadTransformPosLeft = { 0,0,0 };
 	Vector m_EyeToHeadTransformPosRight = { 0,0,0 };
 
+	// Orientations are composed as rotations, the axes and angles below are taken from them
+	Rotation m_HmdRotation;
+	Rotation m_LeftControllerRotation;
+	Rotation m_RightControllerRotation;
+	Rotation m_ViewmodelRotation;
+
 	Vector m_HmdForward;
 	Vector m_HmdRight;
 	Vector m_HmdUp;
@@ -87,13 +135,14 @@ public:
 
 	Vector m_Center = { 0,0,0 };
 	Vector m_SetupOrigin = { 0,0,0 };
+	// Takes tracked positions into the game, kept in step with the fields above by UpdateTransforms
+	TransformChain m_Transforms;
 
 	float m_HeightOffset = 0.0;
 	bool m_RoomscaleActive = false;
 
 	Vector m_LeftControllerPosAbs;											
 	QAngle m_LeftControllerAngAbs;
-	Vector m_RightControllerPosRel;											
 	QAngle m_RightControllerAngAbs;
 
 	Vector m_ViewmodelPosOffset;
@@ -135,6 +184,8 @@ public:
 	bool m_IsVREnabled = false;
 	bool m_IsInitialized = false;
 	bool m_RenderedNewFrame = false;
+	// Set once the frame being built has its poses, until Update hands it to the compositor
+	bool m_FrameBegun = false;
 	bool m_RenderedHud = false;
 	bool m_CreatedVRTextures = false;
 	bool m_DrawCrosshair = false;
@@ -176,6 +227,7 @@ public:
 	TrackedDevicePoseData m_HmdPose;
 	TrackedDevicePoseData m_LeftControllerPose;
 	TrackedDevicePoseData m_RightControllerPose;
+	InputPoseData m_InputPose;
 
 	bool m_ApplyPortalRotationOffset = false;
 	QAngle m_PortalRotationOffset = {0, 0, 0};
@@ -199,12 +251,20 @@ public:
 	float m_PortallingDetectionDistanceThreshold = 35.f; // The distance threshold used to detect portalling
 	bool m_ApplyPitchAndRollPortalRotationOffset = false; // If `true`, the camera pitch/roll follows the exit portal's orientation when portalling
 	float m_CameraUprightRecoverySpeed = 0.2f; // If the above is `true`, this controls how quickly the camera turns back upright after portalling
+	bool m_TraceFrames = false; // Records a frame timeline while `true`, written to FrameTracePath when set back to `false`
+	static constexpr const char *FrameTracePath = "VR\\trace.json";
+	bool m_LateLatch = true; // Re-predicts the HMD pose right before each eye is rendered
+	bool m_LogLatency = false; // Writes each eye's pose latency and the compositor's frame timing to LatencyLogPath while `true`
+	static constexpr const char *LatencyLogPath = "VR\\latency.csv";
+	bool m_LogHookStats = false; // Writes each frame's hook call counts and times to VR\hookstats.csv while `true`, in builds with HOOK_STATS defined
 
 	VR() {};
 	VR(Game *game);
+	void InitRendering();
 	int SetActionManifest(const char *fileName);
 	void InstallApplicationManifest(const char *fileName);
 	void Update();
+	void BeginFrame();
 	void SetScreenSizeOverride(bool bState);
 	void CreateVRTextures();
 	void SubmitVRTextures();
@@ -223,17 +283,25 @@ public:
 	Vector GetRecommendedViewmodelAbsPos(Vector eyePosition);
 	QAngle GetRecommendedViewmodelAbsAngle();
 	void UpdateHMDAngles();
+	void UpdateTransforms();
+	Rotation GetHmdRotation(const Rotation &hmdRotLocal);
+	Rotation GetControllerRotation(const Rotation &controllerRot);
+	bool ResampleInputPose();
+	Vector GetInputRightControllerAbsPos();
+	QAngle GetInputRightControllerAbsAngle();
 	void UpdateTracking();
+	float GetPredictedSecondsToPhotons();
+	EyeViewData LateLatchHmdPose(vr::EVREye eye);
+	void LogLatency(vr::EVREye eye, const char *source, float predictedMs, float extrapolatedMs);
 	Vector GetViewAngle();
-	Vector GetViewOrigin(Vector setupOrigin);
-	Vector GetViewOriginLeft(Vector setupOrigin);
-	Vector GetViewOriginRight(Vector setupOrigin);
+	Vector GetViewOrigin(const Vector &hmdPos, const Rotation &hmdRotation, vr::EVREye eye);
 	bool CheckDigitalActionChanged(vr::VRActionHandle_t& actionHandle, bool& state);
 	bool GetAnalogActionData(vr::VRActionHandle_t &actionHandle, vr::InputAnalogActionData_t &analogDataOut);
 	void ResetPosition();
 	void GetPoseData(vr::TrackedDevicePose_t &poseRaw, TrackedDevicePoseData &poseOut);
+	void GetPoseData(const TrackedPoses &poses, vr::TrackedDeviceIndex_t device, TrackedDevicePoseData &poseOut);
 	void ParseConfigFile();
 	void WaitForConfigUpdate();
 	Vector Trace(uint32_t* localPlayer);
-	Vector TraceEye(uint32_t* localPlayer, Vector cameraPos, Vector eyePos, QAngle& eyeAngle);
+	Vector TraceEye(uint32_t* localPlayer, Vector cameraPos, Vector eyePos, Rotation& eyeRotation);
 };
\ No newline at end of file
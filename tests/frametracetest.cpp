@@ -0,0 +1,205 @@
+// frametracetest.cpp : Unit tests for FrameTrace: ThreadRing wraparound and concurrent reads, and
+// the Chrome trace JSON export.
+//
+// Build and run (Linux):   make -C tests test
+//
+// Exits with 1 if any check failed.
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frametrace.h"
+
+static int g_Checks = 0;
+static int g_Failures = 0;
+
+static void Check(bool passed, const char *what, int line)
+{
+	++g_Checks;
+	if (passed)
+		return;
+
+	++g_Failures;
+	printf("  line %d: %s\n", line, what);
+}
+
+#define CHECK(condition) Check(condition, #condition, __LINE__)
+
+static bool Contains(const std::string &text, const std::string &part)
+{
+	return text.find(part) != std::string::npos;
+}
+
+static void TestWraparound()
+{
+	// Fewer spans than fit, all of them in order
+	FrameTrace::ThreadRing ring(3);
+	for (uint64_t i = 0; i < 10; ++i)
+		ring.Push("span", i * 10, i * 10 + 5);
+
+	std::vector<FrameTrace::Span> spans;
+	ring.Read(spans);
+	CHECK(spans.size() == 10);
+	CHECK(spans.front().start == 0 && spans.back().start == 90);
+	CHECK(spans.front().thread == 3);
+
+	// Past capacity the oldest spans are overwritten. The slot the next span goes into may be being
+	// written while it's read, so the newest Capacity - 1 are read, oldest first.
+	const uint64_t pushed = FrameTrace::Capacity + 100;
+	FrameTrace::ThreadRing full(1);
+	for (uint64_t i = 0; i < pushed; ++i)
+		full.Push("span", i, i + 1);
+
+	spans.clear();
+	full.Read(spans);
+	CHECK(spans.size() == FrameTrace::Capacity - 1);
+	CHECK(spans.front().start == 101);
+	CHECK(spans.back().start == pushed - 1);
+
+	bool ordered = true;
+	for (size_t i = 1; i < spans.size(); ++i)
+		ordered &= spans[i].start == spans[i - 1].start + 1;
+	CHECK(ordered);
+
+	// Read appends, so several rings can go into one list
+	ring.Read(spans);
+	CHECK(spans.size() == FrameTrace::Capacity - 1 + 10);
+}
+
+static void TestConcurrentRead()
+{
+	// The writer wraps around many times while the reader reads, every span read has to be whole
+	FrameTrace::ThreadRing ring(1);
+	std::atomic<bool> done{ false };
+	std::thread writer([&]
+	{
+		for (uint64_t i = 1; i <= FrameTrace::Capacity * 20; ++i)
+			ring.Push(i % 2 ? "odd" : "even", i, i);
+		done = true;
+	});
+
+	bool whole = true;
+	bool ordered = true;
+	int reads = 0;
+	while (!done || reads == 0)
+	{
+		std::vector<FrameTrace::Span> spans;
+		ring.Read(spans);
+		for (size_t i = 0; i < spans.size(); ++i)
+		{
+			whole &= spans[i].start == spans[i].end && strcmp(spans[i].name, spans[i].start % 2 ? "odd" : "even") == 0;
+			if (i)
+				ordered &= spans[i].start == spans[i - 1].start + 1;
+		}
+		++reads;
+	}
+	writer.join();
+
+	CHECK(whole);
+	CHECK(ordered);
+}
+
+static void TestJson()
+{
+	// An outer span with one nested in it on thread 1, and one on thread 2
+	std::vector<FrameTrace::Span> spans = {
+		{ "VR::Update", 1000000, 5000000, 1 },
+		{ "VR::SubmitVRTextures", 2000000, 3500000, 1 },
+		{ "WaitGetPoses", 1500000, 11000000, 2 },
+	};
+	std::string json = FrameTrace::Recorder::ToJson(spans);
+
+	CHECK(json.rfind("{\"traceEvents\":[", 0) == 0);
+	CHECK(Contains(json, "{\"name\":\"VR::Update\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":0.000,\"dur\":4000.000}"));
+	CHECK(Contains(json, "{\"name\":\"VR::SubmitVRTextures\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":1000.000,\"dur\":1500.000}"));
+	CHECK(Contains(json, "{\"name\":\"WaitGetPoses\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":500.000,\"dur\":9500.000}"));
+	CHECK(Contains(json, "\"displayTimeUnit\":\"ms\"}"));
+
+	// Long traces keep nanosecond timestamps instead of turning into 6 digit exponents
+	spans = { { "first", 0, 1, 1 }, { "late", 18000000001ull, 18000002500ull, 1 } };
+	json = FrameTrace::Recorder::ToJson(spans);
+	CHECK(Contains(json, "\"ts\":18000000.001,\"dur\":2.499"));
+
+	// Quotes, backslashes and control characters are escaped
+	spans = { { "say \"hi\" C:\\dir\n\tend", 0, 1000, 1 } };
+	json = FrameTrace::Recorder::ToJson(spans);
+	CHECK(Contains(json, "\"name\":\"say \\\"hi\\\" C:\\\\dir\\u000a\\u0009end\""));
+
+	CHECK(FrameTrace::Recorder::ToJson({}) == "{\"traceEvents\":[\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+static void TestRecorder()
+{
+	FrameTrace::Recorder &recorder = FrameTrace::Recorder::Get();
+
+	// Off, a scope records nothing
+	{
+		FRAME_TRACE_SCOPE("off");
+	}
+	CHECK(recorder.Collect().empty());
+
+	recorder.SetEnabled(true);
+	auto frame = []
+	{
+		FRAME_TRACE_SCOPE("outer");
+		{
+			FRAME_TRACE_SCOPE("inner");
+		}
+	};
+	frame();
+	std::thread other(frame);
+	other.join();
+	recorder.SetEnabled(false);
+
+	std::vector<FrameTrace::Span> spans = recorder.Collect();
+	CHECK(spans.size() == 4);
+
+	// Each thread has its own id, and its inner span lies within its outer one
+	int threads[2] = {};
+	int found = 0;
+	for (const FrameTrace::Span &outer : spans)
+	{
+		if (strcmp(outer.name, "outer") != 0)
+			continue;
+		for (const FrameTrace::Span &inner : spans)
+		{
+			if (strcmp(inner.name, "inner") == 0 && inner.thread == outer.thread)
+				CHECK(inner.start >= outer.start && inner.end <= outer.end);
+		}
+		if (found < 2)
+			threads[found++] = outer.thread;
+	}
+	CHECK(found == 2);
+	CHECK(threads[0] != threads[1]);
+
+	std::string json = recorder.ExportJson();
+	CHECK(Contains(json, "\"tid\":" + std::to_string(threads[0])));
+	CHECK(Contains(json, "\"tid\":" + std::to_string(threads[1])));
+
+	// Enabling again only collects what was recorded since
+	recorder.SetEnabled(true);
+	CHECK(recorder.Collect().empty());
+	recorder.SetEnabled(false);
+}
+
+int main()
+{
+	struct { const char *name; void (*run)(); } tests[] = {
+		{ "wraparound", TestWraparound },
+		{ "concurrent read", TestConcurrentRead },
+		{ "json", TestJson },
+		{ "recorder", TestRecorder },
+	};
+
+	for (const auto &test : tests)
+	{
+		int failures = g_Failures;
+		test.run();
+		printf("%-16s %s\n", test.name, g_Failures == failures ? "ok" : "FAILED");
+	}
+
+	printf("%d check(s), %d failed\n", g_Checks, g_Failures);
+	return g_Failures ? 1 : 0;
+}
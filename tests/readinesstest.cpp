@@ -0,0 +1,239 @@
+// readinesstest.cpp : Unit tests for Readiness driven by ScriptedModuleSource: Wait and OnReady as
+// modules come in, modules loaded before Start, probing when the source can't start, and tearing
+// down while the script still runs.
+//
+// Build and run (Linux):   make -C tests test
+//
+// Exits with 1 if any check failed.
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "readiness.h"
+
+using namespace std::chrono_literals;
+
+static int g_Checks = 0;
+static int g_Failures = 0;
+
+static void Check(bool passed, const char *what, int line)
+{
+	++g_Checks;
+	if (passed)
+		return;
+
+	++g_Failures;
+	printf("  line %d: %s\n", line, what);
+}
+
+#define CHECK(condition) Check(condition, #condition, __LINE__)
+
+// Readiness::Wait has no timeout, a dependency that never comes would hang the test instead of failing it
+static bool WaitFor(Readiness &readiness, const std::string &name)
+{
+	auto waited = std::async(std::launch::async, [&] { readiness.Wait(name); });
+	if (waited.wait_for(2s) == std::future_status::ready)
+		return true;
+
+	printf("  waiting for %s timed out\n", name.c_str());
+	fflush(stdout);
+	std::_Exit(1);
+}
+
+// What the OnReady callbacks saw, in order
+struct Log
+{
+	std::mutex mutex;
+	std::vector<std::string> entries;
+	std::vector<std::thread::id> threads;
+
+	std::function<void()> Entry(const std::string &entry)
+	{
+		return [this, entry]
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			entries.push_back(entry);
+			threads.push_back(std::this_thread::get_id());
+		};
+	}
+
+	size_t Size()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return entries.size();
+	}
+
+	// Callbacks run after Wait may already have returned
+	bool WaitForSize(size_t size)
+	{
+		auto timeout = std::chrono::steady_clock::now() + 2s;
+		while (Size() < size && std::chrono::steady_clock::now() < timeout)
+			std::this_thread::sleep_for(1ms);
+		return Size() == size;
+	}
+};
+
+// A source that can't report loads, like LoaderModuleSource without LdrRegisterDllNotification
+class UnstartableSource : public IModuleSource
+{
+public:
+	bool Start(std::function<void(const std::string &name)>) override
+	{
+		return false;
+	}
+
+	bool IsLoaded(const std::string &name) const override
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Asked.insert(name);
+		return m_Loaded.count(name) != 0;
+	}
+
+	void Load(const std::string &name)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Loaded.insert(name);
+	}
+
+	bool Asked(const std::string &name) const
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Asked.count(name) != 0;
+	}
+
+private:
+	mutable std::mutex m_Mutex;
+	std::set<std::string> m_Loaded;
+	mutable std::set<std::string> m_Asked;
+};
+
+static void TestWaitAndOnReady()
+{
+	Readiness readiness(std::make_unique<ScriptedModuleSource>(std::vector<ScriptedModuleSource::Step>{
+		{ 20ms, "Client.dll" },
+		{ 20ms, "engine.dll" },
+	}));
+	Log log;
+
+	CHECK(!readiness.IsReady("client.dll"));
+	readiness.OnReady("engine.dll", log.Entry("engine"));
+	readiness.OnReady("client.dll", log.Entry("client 1"));
+	readiness.OnReady("CLIENT.DLL", log.Entry("client 2"));
+
+	// Names are case-insensitive, the script reports Client.dll
+	CHECK(WaitFor(readiness, "client.DLL"));
+	CHECK(readiness.IsReady("client.dll"));
+	CHECK(WaitFor(readiness, "engine.dll"));
+
+	// Each module's callbacks in the order they were added, modules in the order they loaded,
+	// all of them on the readiness thread
+	CHECK(log.WaitForSize(3));
+	CHECK(log.entries == std::vector<std::string>({ "client 1", "client 2", "engine" }));
+	for (std::thread::id thread : log.threads)
+		CHECK(thread != std::this_thread::get_id());
+
+	// Once ready, OnReady runs the callback right away on the calling thread
+	readiness.OnReady("client.dll", log.Entry("late"));
+	CHECK(log.Size() == 4);
+	CHECK(log.entries.back() == "late" && log.threads.back() == std::this_thread::get_id());
+}
+
+static void TestLoadedBeforeStart()
+{
+	Readiness readiness(std::make_unique<ScriptedModuleSource>(std::vector<ScriptedModuleSource::Step>{},
+		std::vector<std::string>{ "Engine.dll" }));
+	Log log;
+
+	// The source never reports these, Readiness has to ask it
+	CHECK(readiness.IsReady("engine.dll"));
+	CHECK(WaitFor(readiness, "ENGINE.DLL"));
+	readiness.OnReady("engine.dll", log.Entry("engine"));
+	CHECK(log.Size() == 1);
+
+	// With the source running, a module that isn't loaded is left to it rather than probed
+	readiness.OnReady("server.dll", log.Entry("server"));
+	std::this_thread::sleep_for(20ms);
+	CHECK(!readiness.IsReady("server.dll"));
+	CHECK(log.Size() == 1);
+}
+
+static void TestProbeWhenStartFails()
+{
+	auto owned = std::make_unique<UnstartableSource>();
+	UnstartableSource *source = owned.get();
+	Readiness readiness(std::move(owned));
+	Log log;
+
+	// Nothing will report it, so it's probed until the source says it's there
+	CHECK(!readiness.IsReady("Server.dll"));
+	readiness.OnReady("server.dll", log.Entry("server"));
+	std::this_thread::sleep_for(20ms);
+	CHECK(log.Size() == 0);
+
+	source->Load("server.dll");
+	CHECK(WaitFor(readiness, "server.dll"));
+	CHECK(log.WaitForSize(1));
+
+	// The device is only ever probed, the source isn't asked for it
+	std::atomic<bool> device{ false };
+	readiness.AddProbe(Readiness::D3DDevice, [&] { return device.load(); });
+	CHECK(!readiness.IsReady(Readiness::D3DDevice));
+	device = true;
+	CHECK(WaitFor(readiness, Readiness::D3DDevice));
+	CHECK(!source->Asked(Readiness::D3DDevice));
+}
+
+static void TestDestroyWhileScriptRuns()
+{
+	Log log;
+	auto started = std::chrono::steady_clock::now();
+	{
+		Readiness readiness(std::make_unique<ScriptedModuleSource>(std::vector<ScriptedModuleSource::Step>{
+			{ 5ms, "client.dll" },
+			{ 10s, "never.dll" },
+		}));
+		readiness.OnReady("never.dll", log.Entry("never"));
+		CHECK(WaitFor(readiness, "client.dll"));
+	}
+
+	// The script stops where it is instead of holding up the destructor
+	CHECK(std::chrono::steady_clock::now() - started < 2s);
+	CHECK(log.Size() == 0);
+
+	// A script reporting as fast as it can while Readiness goes away
+	std::vector<ScriptedModuleSource::Step> burst;
+	for (int i = 0; i < 500; ++i)
+		burst.push_back({ 0ms, "module" + std::to_string(i) + ".dll" });
+
+	for (int run = 0; run < 20; ++run)
+	{
+		Readiness readiness(std::make_unique<ScriptedModuleSource>(burst));
+		readiness.OnReady("module10.dll", log.Entry("module10"));
+	}
+	CHECK(log.Size() <= 20);
+}
+
+int main()
+{
+	struct { const char *name; void (*run)(); } tests[] = {
+		{ "wait and on ready", TestWaitAndOnReady },
+		{ "loaded before start", TestLoadedBeforeStart },
+		{ "probe when start fails", TestProbeWhenStartFails },
+		{ "destroy while script runs", TestDestroyWhileScriptRuns },
+	};
+
+	for (const auto &test : tests)
+	{
+		int failures = g_Failures;
+		test.run();
+		printf("%-26s %s\n", test.name, g_Failures == failures ? "ok" : "FAILED");
+	}
+
+	printf("%d check(s), %d failed\n", g_Checks, g_Failures);
+	return g_Failures ? 1 : 0;
+}
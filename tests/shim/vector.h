@@ -0,0 +1,71 @@
+// Stand-in for the SDK's vector.h when building the tests without MSVC. Only what the headers under
+// test and the tests use, with the same layout and semantics as the SDK versions.
+#pragma once
+#include <cmath>
+
+#define M_PI_F		((float)(3.14159265358979323846))
+#define DEG2RAD( x  )  ( (float)(x) * (float)(M_PI_F / 180.f) )
+
+typedef float vec_t;
+
+class Vector
+{
+public:
+	vec_t x, y, z;
+
+	Vector() = default;
+	Vector(vec_t X, vec_t Y, vec_t Z) : x(X), y(Y), z(Z) {}
+
+	Vector operator+(const Vector &v) const { return Vector(x + v.x, y + v.y, z + v.z); }
+	Vector operator-(const Vector &v) const { return Vector(x - v.x, y - v.y, z - v.z); }
+	Vector operator*(float f) const { return Vector(x * f, y * f, z * f); }
+	Vector &operator+=(const Vector &v) { x += v.x; y += v.y; z += v.z; return *this; }
+	Vector &operator-=(const Vector &v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+};
+
+struct matrix3x4_t
+{
+	matrix3x4_t() = default;
+	matrix3x4_t(
+		float m00, float m01, float m02, float m03,
+		float m10, float m11, float m12, float m13,
+		float m20, float m21, float m22, float m23)
+	{
+		m_matrix[0][0] = m00;
+		m_matrix[0][1] = m01;
+		m_matrix[0][2] = m02;
+		m_matrix[0][3] = m03;
+		m_matrix[1][0] = m10;
+		m_matrix[1][1] = m11;
+		m_matrix[1][2] = m12;
+		m_matrix[1][3] = m13;
+		m_matrix[2][0] = m20;
+		m_matrix[2][1] = m21;
+		m_matrix[2][2] = m22;
+		m_matrix[2][3] = m23;
+	}
+
+	float *operator[](int i)
+	{
+		return m_matrix[i];
+	}
+
+	const float *operator[](int i) const
+	{
+		return m_matrix[i];
+	}
+
+	float m_matrix[3][4];
+};
+
+inline void VectorPivotXY(Vector &point, const Vector &pivot, float degrees)
+{
+	float s = sin(degrees * 3.14159265 / 180);
+	float c = cos(degrees * 3.14159265 / 180);
+	point.x -= pivot.x;
+	point.y -= pivot.y;
+	float xnew = point.x * c - point.y * s;
+	float ynew = point.x * s + point.y * c;
+	point.x = xnew + pivot.x;
+	point.y = ynew + pivot.y;
+}
@@ -0,0 +1,184 @@
+// taskgraphtest.cpp : Unit tests for TaskGraph with stub tasks: dependency order, failures skipping
+// their dependents, and running a graph again.
+//
+// Build and run (Linux):   make -C tests test
+//
+// Exits with 1 if any check failed.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "taskgraph.h"
+
+static int g_Checks = 0;
+static int g_Failures = 0;
+
+static void Check(bool passed, const char *what, int line)
+{
+	++g_Checks;
+	if (passed)
+		return;
+
+	++g_Failures;
+	printf("  line %d: %s\n", line, what);
+}
+
+#define CHECK(condition) Check(condition, #condition, __LINE__)
+
+// Order the stub tasks ran in, and the observer's events
+struct Log
+{
+	std::mutex mutex;
+	std::vector<std::string> entries;
+
+	void Add(const std::string &entry)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entries.push_back(entry);
+	}
+
+	int IndexOf(const std::string &entry)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto found = std::find(entries.begin(), entries.end(), entry);
+		return found == entries.end() ? -1 : (int)(found - entries.begin());
+	}
+
+	bool Contains(const std::string &entry) { return IndexOf(entry) >= 0; }
+};
+
+static bool Contains(const std::vector<std::string> &lines, const std::string &line)
+{
+	return std::find(lines.begin(), lines.end(), line) != lines.end();
+}
+
+static void TestDependencyOrder()
+{
+	ThreadPool pool(4);
+	TaskGraph graph;
+	Log ran;
+
+	// Both middle tasks wait until the other one started, so they only finish if they run in parallel
+	std::atomic<int> middleStarted{ 0 };
+	auto middle = [&](const char *name)
+	{
+		return [&, name]
+		{
+			++middleStarted;
+			auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while (middleStarted < 2 && std::chrono::steady_clock::now() < timeout)
+				std::this_thread::yield();
+			ran.Add(std::string(name) + (middleStarted < 2 ? " alone" : ""));
+		};
+	};
+
+	int first = graph.Add("first", {}, [&] { ran.Add("first"); });
+	int left = graph.Add("left", { first }, middle("left"));
+	int right = graph.Add("right", { first }, middle("right"));
+	graph.Add("last", { left, right }, [&] { ran.Add("last"); });
+
+	CHECK(graph.Run(pool));
+	CHECK(graph.Errors().empty());
+	CHECK(ran.entries.size() == 4);
+	CHECK(ran.IndexOf("first") == 0);
+	CHECK(ran.IndexOf("left") > 0);
+	CHECK(ran.IndexOf("right") > 0);
+	CHECK(ran.IndexOf("last") == 3);
+
+	// A task can only depend on tasks added before it
+	bool threw = false;
+	try
+	{
+		graph.Add("cycle", { 4 }, [] {});
+	}
+	catch (const std::invalid_argument &)
+	{
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+static void TestFailure()
+{
+	ThreadPool pool(4);
+	TaskGraph graph;
+	Log ran;
+	Log events;
+	graph.SetObserver([&](const std::string &event) { events.Add(event); });
+
+	int broken = graph.Add("broken", {}, [] { throw std::runtime_error("signature not found"); });
+	int dependent = graph.Add("dependent", { broken }, [&] { ran.Add("dependent"); });
+	graph.Add("indirect", { dependent }, [&] { ran.Add("indirect"); });
+	graph.Add("independent", {}, [&] { ran.Add("independent"); });
+
+	CHECK(!graph.Run(pool));
+	CHECK(!ran.Contains("dependent"));
+	CHECK(!ran.Contains("indirect"));
+	CHECK(ran.Contains("independent"));
+
+	std::vector<std::string> errors = graph.Errors();
+	CHECK(errors.size() == 3);
+	CHECK(Contains(errors, "broken: signature not found"));
+	CHECK(Contains(errors, "dependent: skipped, broken failed"));
+	CHECK(Contains(errors, "indirect: skipped, dependent failed"));
+
+	CHECK(events.Contains("broken started"));
+	CHECK(events.Contains("broken failed, signature not found"));
+	CHECK(events.Contains("dependent skipped, broken failed"));
+	CHECK(!events.Contains("dependent started"));
+	CHECK(events.Contains("independent done"));
+
+	// Anything that isn't a std::exception fails the task too
+	TaskGraph thrower;
+	thrower.Add("thrower", {}, [] { throw 42; });
+	CHECK(!thrower.Run(pool));
+	CHECK(Contains(thrower.Errors(), "thrower: unknown exception"));
+}
+
+static void TestRerun()
+{
+	ThreadPool pool(2);
+	TaskGraph graph;
+	std::atomic<int> runs[3] = {};
+	bool fail = true;
+
+	int a = graph.Add("a", {}, [&] { ++runs[0]; });
+	int b = graph.Add("b", { a }, [&] { ++runs[1]; if (fail) throw std::runtime_error("not yet"); });
+	graph.Add("c", { b }, [&] { ++runs[2]; });
+
+	CHECK(!graph.Run(pool));
+	CHECK(runs[0] == 1 && runs[1] == 1 && runs[2] == 0);
+
+	// A second run starts over: every task runs again and the last run's errors are gone
+	fail = false;
+	CHECK(graph.Run(pool));
+	CHECK(graph.Errors().empty());
+	CHECK(runs[0] == 2 && runs[1] == 2 && runs[2] == 1);
+
+	CHECK(graph.Run(pool));
+	CHECK(runs[0] == 3 && runs[1] == 3 && runs[2] == 2);
+}
+
+int main()
+{
+	struct { const char *name; void (*run)(); } tests[] = {
+		{ "dependency order", TestDependencyOrder },
+		{ "failure", TestFailure },
+		{ "rerun", TestRerun },
+	};
+
+	for (const auto &test : tests)
+	{
+		int failures = g_Failures;
+		test.run();
+		printf("%-18s %s\n", test.name, g_Failures == failures ? "ok" : "FAILED");
+	}
+
+	printf("%d check(s), %d failed\n", g_Checks, g_Failures);
+	return g_Failures ? 1 : 0;
+}
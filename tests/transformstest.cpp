@@ -0,0 +1,246 @@
+// transformstest.cpp : Unit tests for TransformChain, checked against the formulas vr.cpp used
+// before positions went through it: pivot the offset from the play area center by the rotation
+// offset's yaw, scale it, add it to the setup origin.
+//
+// Build and run (Linux):   make -C tests test
+//   shim/vector.h stands in for the SDK's vector.h, which only builds with MSVC.
+//
+// Exits with 1 if any check failed.
+#include <cmath>
+#include <cstdio>
+#include "transforms.h"
+
+static int g_Checks = 0;
+static int g_Failures = 0;
+
+static void CheckNear(const Vector &actual, const Vector &expected, const char *what, int line)
+{
+	++g_Checks;
+	const float tolerance = 1e-3f;
+	if (fabsf(actual.x - expected.x) <= tolerance && fabsf(actual.y - expected.y) <= tolerance && fabsf(actual.z - expected.z) <= tolerance)
+		return;
+
+	++g_Failures;
+	printf("  line %d: %s is (%g, %g, %g), expected (%g, %g, %g)\n", line, what,
+		actual.x, actual.y, actual.z, expected.x, expected.y, expected.z);
+}
+
+#define CHECK_NEAR(actual, expected) CheckNear(actual, expected, #actual, __LINE__)
+
+// The state VR feeds the chain from, see VR::UpdateTransforms
+struct Player
+{
+	Vector center = { 0, 0, 0 };
+	float scale = 1;
+	float yaw = 0;
+	Vector origin = { 0, 0, 0 };
+
+	void Apply(TransformChain &transforms) const
+	{
+		transforms.SetAnchor(center, scale);
+		transforms.SetYaw(yaw);
+		transforms.SetOrigin(origin);
+	}
+
+	Vector Reference(const Vector &tracked) const
+	{
+		Vector offset = tracked - center;
+		VectorPivotXY(offset, { 0, 0, 0 }, yaw);
+		return origin + offset * scale;
+	}
+
+	// Snap and smooth turning keep the yaw in [0, 360) like VR::ProcessInput
+	void Turn(float degrees)
+	{
+		yaw += degrees;
+		yaw -= 360 * std::floor(yaw / 360);
+	}
+};
+
+static void TestComposition()
+{
+	TransformChain transforms;
+	Player player;
+	player.center = { 0.3f, -0.2f, 0 };
+	player.scale = 43.2f;
+	player.yaw = 37;
+	player.origin = { 1024, -512, 64 };
+	player.Apply(transforms);
+
+	const Vector tracked = { 0.7f, 0.4f, 1.6f };
+	CHECK_NEAR(transforms.Point(TransformChain::Tracking, tracked), tracked);
+	CHECK_NEAR(transforms.Point(TransformChain::PlayArea, tracked), (tracked - player.center) * player.scale);
+	CHECK_NEAR(transforms.Point(TransformChain::Player, tracked), player.Reference(tracked) - player.origin);
+	CHECK_NEAR(transforms.Point(TransformChain::World, tracked), player.Reference(tracked));
+
+	// Offsets don't move with the center or the origin
+	Vector offset = { 0.1f, -0.3f, 0.2f };
+	Vector expected = offset * player.scale;
+	VectorPivotXY(expected, { 0, 0, 0 }, player.yaw);
+	CHECK_NEAR(transforms.Direction(TransformChain::World, offset), expected);
+}
+
+static void TestSnapTurn()
+{
+	TransformChain transforms;
+	Player player;
+	player.center = { 0, 0, 0 };
+	player.scale = 40;
+	player.origin = { 100, 200, 0 };
+	player.Apply(transforms);
+
+	const Vector hmd = { 0, 0, 1.7f };
+	const Vector hand = { 0.5f, 0, 1.2f };
+	const Vector handStart = transforms.Point(TransformChain::World, hand);
+
+	player.Turn(45);
+	player.Apply(transforms);
+
+	// Turning pivots around the play area center, the head above it stays put
+	CHECK_NEAR(transforms.Point(TransformChain::World, hmd), Vector(100, 200, 68));
+	CHECK_NEAR(transforms.Point(TransformChain::World, hand), Vector(100 + 10 * sqrtf(2), 200 + 10 * sqrtf(2), 48));
+	CHECK_NEAR(transforms.Point(TransformChain::World, hand), player.Reference(hand));
+
+	// A full turn back the other way, the yaw wraps through 0
+	for (int i = 0; i < 9; ++i)
+	{
+		player.Turn(-45);
+		player.Apply(transforms);
+		CHECK_NEAR(transforms.Point(TransformChain::World, hand), player.Reference(hand));
+	}
+	CHECK_NEAR(transforms.Point(TransformChain::World, hand), handStart);
+
+	// Away from the center the head swings around it
+	const Vector offCenter = { 1, 0, 1.7f };
+	player.Turn(90);
+	player.Apply(transforms);
+	CHECK_NEAR(transforms.Point(TransformChain::World, offCenter), Vector(100, 240, 68));
+}
+
+static void TestRecenter()
+{
+	TransformChain transforms;
+	Player player;
+	player.scale = 40;
+	player.yaw = 120;
+	player.origin = { -300, 50, 10 };
+	player.Apply(transforms);
+
+	// Walked away from the center of the play area
+	const Vector hmd = { 1.2f, -0.8f, 1.7f };
+	CHECK_NEAR(transforms.Point(TransformChain::World, hmd), player.Reference(hmd));
+
+	// Standing, VR::ResetPosition keeps the center on the floor: the head goes back over the origin
+	player.center = { hmd.x, hmd.y, 0 };
+	player.Apply(transforms);
+	CHECK_NEAR(transforms.Point(TransformChain::World, hmd), Vector(-300, 50, 10 + 1.7f * 40));
+	CHECK_NEAR(transforms.Point(TransformChain::World, hmd), player.Reference(hmd));
+
+	// Moving after it follows the turned play area
+	const Vector step = { 0.5f, 0, 0 };
+	Vector expected = step * player.scale;
+	VectorPivotXY(expected, { 0, 0, 0 }, player.yaw);
+	CHECK_NEAR(transforms.Point(TransformChain::World, hmd + step), Vector(-300, 50, 10 + 1.7f * 40) + expected);
+
+	// Seated, the head itself is the center
+	player.center = hmd;
+	player.Apply(transforms);
+	CHECK_NEAR(transforms.Point(TransformChain::World, hmd), player.origin);
+
+	// Without 6DOF VR anchors the chain on the head every frame, wherever it goes
+	const Vector leaned = { 1.5f, -0.6f, 1.5f };
+	player.center = leaned;
+	player.Apply(transforms);
+	CHECK_NEAR(transforms.Point(TransformChain::World, leaned), player.origin);
+}
+
+static void TestPortalling()
+{
+	TransformChain transforms;
+	Player player;
+	player.center = { 0, 0, 0 };
+	player.scale = 40;
+	player.yaw = 10;
+	player.origin = { 500, 500, 0 };
+	player.Apply(transforms);
+
+	const Vector hmd = { 0.4f, 0.3f, 1.7f };
+	const Vector hand = { 0.6f, 0.1f, 1.1f };
+	const Vector handFromHead = transforms.Point(TransformChain::World, hand) - transforms.Point(TransformChain::World, hmd);
+
+	// Going through a portal turns the player by the portals' yaw difference and moves the origin
+	// to the exit, see dRenderView
+	player.Turn(90);
+	player.origin = { -2000, 750, 256 };
+	player.Apply(transforms);
+
+	CHECK_NEAR(transforms.Point(TransformChain::World, hmd), player.Reference(hmd));
+	CHECK_NEAR(transforms.Point(TransformChain::World, hand), player.Reference(hand));
+
+	// The body comes out the other side the same way around, turned with the exit
+	Vector expected = handFromHead;
+	VectorPivotXY(expected, { 0, 0, 0 }, 90);
+	CHECK_NEAR(transforms.Point(TransformChain::World, hand) - transforms.Point(TransformChain::World, hmd), expected);
+
+	// And back out again
+	player.Turn(-90);
+	player.origin = { 500, 500, 0 };
+	player.Apply(transforms);
+	CHECK_NEAR(transforms.Point(TransformChain::World, hand) - transforms.Point(TransformChain::World, hmd), handFromHead);
+}
+
+static void TestCaching()
+{
+	TransformChain transforms;
+	Player player;
+	player.center = { 0.2f, 0.2f, 0 };
+	player.scale = 40;
+	player.yaw = 30;
+	player.origin = { 10, 20, 30 };
+	player.Apply(transforms);
+
+	const Vector tracked = { 1, 2, 1.5f };
+	CHECK_NEAR(transforms.Point(TransformChain::World, tracked), player.Reference(tracked));
+
+	// A new origin only moves the world, the player space transform is kept
+	const Vector inPlayer = transforms.Point(TransformChain::Player, tracked);
+	player.origin = { -10, -20, -30 };
+	player.Apply(transforms);
+	CHECK_NEAR(transforms.Point(TransformChain::Player, tracked), inPlayer);
+	CHECK_NEAR(transforms.Point(TransformChain::World, tracked), player.Reference(tracked));
+
+	// Changing a link after only a closer space was composed again still reaches the world
+	player.yaw = 200;
+	player.Apply(transforms);
+	CHECK_NEAR(transforms.Point(TransformChain::PlayArea, tracked), (tracked - player.center) * player.scale);
+	player.center = { -0.5f, 0.5f, 0 };
+	player.scale = 52;
+	player.Apply(transforms);
+	CHECK_NEAR(transforms.Point(TransformChain::World, tracked), player.Reference(tracked));
+
+	// Setting what's already there changes nothing
+	player.Apply(transforms);
+	player.Apply(transforms);
+	CHECK_NEAR(transforms.Point(TransformChain::World, tracked), player.Reference(tracked));
+}
+
+int main()
+{
+	struct { const char *name; void (*run)(); } tests[] = {
+		{ "composition", TestComposition },
+		{ "snap turn", TestSnapTurn },
+		{ "recenter", TestRecenter },
+		{ "portalling", TestPortalling },
+		{ "caching", TestCaching },
+	};
+
+	for (const auto &test : tests)
+	{
+		int failures = g_Failures;
+		test.run();
+		printf("%-12s %s\n", test.name, g_Failures == failures ? "ok" : "FAILED");
+	}
+
+	printf("%d check(s), %d failed\n", g_Checks, g_Failures);
+	return g_Failures ? 1 : 0;
+}
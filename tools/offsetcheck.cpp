@@ -0,0 +1,481 @@
+// offsetcheck.cpp : Verifies every signature in the offset table against the DLLs of a game build
+// on disk, without starting the game.
+//
+// Build (Linux):   g++ -std=c++17 -O2 -I../L4D2VR offsetcheck.cpp -o offsetcheck
+// Build (Windows): cl /std:c++17 /O2 /EHsc /I..\L4D2VR offsetcheck.cpp
+//
+// Usage: offsetcheck [--repeat N] [--suggest] [--make <module> <rva>]... <bin dir> [more bin dirs...]
+//   Portal 2 keeps engine.dll/materialsystem.dll in "Portal 2/bin" and client.dll/server.dll in
+//   "Portal 2/portal2/bin", pass both. Exits with 1 if any signature wasn't found.
+//   --suggest  also prints how short each signature could be while staying unique, and a freshly
+//              generated shortest unique signature as a line for offsettable.h.
+//   --make     only generates the shortest unique signature for a function at the given RVA.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include "offsettable.h"
+#include "offsetcache.h"
+
+namespace fs = std::filesystem;
+
+static std::string ToLower(std::string str)
+{
+	std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return str;
+}
+
+// Back to the notation used in offsettable.h
+static std::string ToString(const Pattern &pattern)
+{
+	std::string text;
+	char byte[4];
+	for (size_t i = 0; i < pattern.length; ++i)
+	{
+		if (i)
+			text += ' ';
+		if (pattern.mask[i])
+		{
+			snprintf(byte, sizeof(byte), "%02X", pattern.bytes[i]);
+			text += byte;
+		}
+		else
+		{
+			text += '?';
+		}
+	}
+	return text;
+}
+
+// The resolve steps of an offset the way they're written in offsettable.h
+static std::string StepsText(const Offset &offset)
+{
+	std::string text;
+	char step[32];
+	for (int i = 0; i < offset.stepCount; ++i)
+	{
+		const ResolveStep &s = offset.steps[i];
+		switch (s.kind)
+		{
+		case ResolveStep::Rel32: snprintf(step, sizeof(step), ".Rel32()"); break;
+		case ResolveStep::Deref: snprintf(step, sizeof(step), ".Deref()"); break;
+		case ResolveStep::Add: snprintf(step, sizeof(step), ".Add(%s0x%X)", s.value < 0 ? "-" : "", s.value < 0 ? -s.value : s.value); break;
+		case ResolveStep::VTable: snprintf(step, sizeof(step), ".VTable(%d)", s.value); break;
+		}
+		text += step;
+	}
+	return text;
+}
+
+static void PrintEntry(const char *name, const std::string &moduleName, uint32_t offset, const std::string &signature, int sigOffset, const std::string &steps = {})
+{
+	printf("    static constexpr Offset %s = %s{ \"%s\", \"%s\", 0x%X, \"%s\"_sig", name, steps.empty() ? "" : "Offset", name, moduleName.c_str(), offset, signature.c_str());
+	if (sigOffset)
+		printf(", %d", sigOffset);
+	printf(" }%s;\n", steps.c_str());
+}
+
+static int Depth(const Offset &offset)
+{
+	return offset.base ? Depth(*offset.base) + 1 : 0;
+}
+
+// Case-insensitive, the DLL names in the table don't always match the case on disk
+static bool FindModuleFile(const std::vector<fs::path> &dirs, const std::string &moduleName, fs::path &out)
+{
+	const std::string wanted = ToLower(moduleName);
+	for (const fs::path &dir : dirs)
+	{
+		std::error_code error;
+		for (const fs::directory_entry &entry : fs::directory_iterator(dir, error))
+		{
+			if (entry.is_regular_file() && ToLower(entry.path().filename().string()) == wanted)
+			{
+				out = entry.path();
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// A DLL from disk with the regions each SectionKind scans
+struct Module
+{
+	fs::path path;
+	MappedFile file;
+	PEImage pe;
+	std::vector<ImageRegion> regions[3];
+	// Every byte the loader patches when rebasing, sorted
+	std::vector<uint32_t> relocated;
+
+	const std::vector<ImageRegion> &Regions(SectionKind kind) const { return regions[(size_t)kind]; }
+
+	bool Load(const std::vector<fs::path> &dirs, const std::string &moduleName)
+	{
+		if (!FindModuleFile(dirs, moduleName, path) || !file.Open(path.string()) || !pe.Parse(file.m_Data, file.m_Size, true))
+			return false;
+
+		for (size_t kind = 0; kind < std::size(regions); ++kind)
+			regions[kind] = pe.Regions((SectionKind)kind);
+
+		pe.ForEachRelocation([&](uint32_t rva, int width)
+		{
+			for (int i = 0; i < width; ++i)
+				relocated.push_back(rva + i);
+		});
+		std::sort(relocated.begin(), relocated.end());
+		return true;
+	}
+
+	bool IsRelocated(uint32_t rva) const
+	{
+		return std::binary_search(relocated.begin(), relocated.end(), rva);
+	}
+};
+
+static const ImageRegion *FindRegion(const std::vector<ImageRegion> &regions, uint32_t rva)
+{
+	for (const ImageRegion &region : regions)
+	{
+		if (rva >= region.rva && rva - region.rva < region.size)
+			return &region;
+	}
+	return nullptr;
+}
+
+// Vectorized single-pattern scan over every region, counting all matches
+static PatternMatches FindAll(const std::vector<ImageRegion> &regions, const Pattern &pattern)
+{
+	PatternMatches result;
+	for (const ImageRegion &region : regions)
+	{
+		for (size_t found = SigScanner::FindPattern(region.data, region.size, pattern); found != SigScanner::npos;
+			found = SigScanner::FindPattern(region.data, region.size, pattern, found + 1))
+		{
+			if (result.count++ == 0)
+				result.first = region.rva + found;
+		}
+	}
+	return result;
+}
+
+// Stops counting at limit, uniqueness checks only need to tell 1 from more
+static int CountMatches(const std::vector<ImageRegion> &regions, const Pattern &pattern, int limit)
+{
+	// A pattern without a single fixed byte has no anchor and matches everywhere
+	if (!pattern.mask[pattern.anchor])
+		return limit;
+
+	int count = 0;
+	for (const ImageRegion &region : regions)
+	{
+		for (size_t found = SigScanner::FindPattern(region.data, region.size, pattern); found != SigScanner::npos;
+			found = SigScanner::FindPattern(region.data, region.size, pattern, found + 1))
+		{
+			if (++count == limit)
+				return count;
+		}
+	}
+	return count;
+}
+
+static Pattern Prefix(const Pattern &pattern, size_t length)
+{
+	Pattern prefix = pattern;
+	std::fill(prefix.mask + length, prefix.mask + prefix.length, 0);
+	prefix.length = length;
+	prefix.PickAnchors();
+	return prefix;
+}
+
+// Length of the shortest prefix of a pattern that still matches only once, 0 if the whole
+// pattern already matches more than once. Matches only get fewer as a prefix grows, so this
+// is a binary search.
+static size_t ShortestUniquePrefix(const std::vector<ImageRegion> &regions, const Pattern &pattern)
+{
+	if (CountMatches(regions, pattern, 2) != 1)
+		return 0;
+
+	size_t low = 1, high = pattern.length;
+	while (low < high)
+	{
+		size_t mid = (low + high) / 2;
+		if (CountMatches(regions, Prefix(pattern, mid), 2) == 1)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	return low;
+}
+
+// Up to Pattern::MaxSize bytes starting at rva, with the bytes that change between builds even
+// when the code itself doesn't as wildcards: relocated absolute addresses and the rel32 operands
+// of calls and jumps into code. The rel32 detection doesn't decode instructions, a false hit
+// only costs an extra wildcard.
+static bool WindowAt(const Module &module, SectionKind kind, uint32_t rva, Pattern &out)
+{
+	const std::vector<ImageRegion> &regions = module.Regions(kind);
+	const ImageRegion *region = FindRegion(regions, rva);
+	if (!region)
+		return false;
+
+	const uint8_t *bytes = region->data + (rva - region->rva);
+	out = Pattern();
+	out.length = std::min<size_t>(Pattern::MaxSize, region->size - (rva - region->rva));
+	for (size_t i = 0; i < out.length; ++i)
+	{
+		out.bytes[i] = bytes[i];
+		out.mask[i] = module.IsRelocated(rva + (uint32_t)i) ? 0 : 0xFF;
+	}
+
+	if (kind != SectionKind::Data)
+	{
+		const std::vector<ImageRegion> &code = module.Regions(SectionKind::Code);
+		for (size_t i = 0; i < out.length; ++i)
+		{
+			size_t operand = 0;
+			if (bytes[i] == 0xE8 || bytes[i] == 0xE9) // call/jmp rel32
+				operand = i + 1;
+			else if (bytes[i] == 0x0F && i + 1 < out.length && (bytes[i + 1] & 0xF0) == 0x80) // jcc rel32
+				operand = i + 2;
+
+			if (!operand || operand + 4 > out.length)
+				continue;
+
+			int32_t rel;
+			memcpy(&rel, bytes + operand, 4);
+			const uint32_t target = rva + (uint32_t)(operand + 4) + (uint32_t)rel;
+			if (FindRegion(code, target))
+			{
+				std::fill(out.mask + operand, out.mask + operand + 4, 0);
+				i = operand + 3;
+			}
+		}
+	}
+
+	out.PickAnchors();
+	return true;
+}
+
+// Shortest signature starting at rva that only matches there, empty if even Pattern::MaxSize
+// bytes aren't unique
+static std::string GenerateSignature(const Module &module, SectionKind kind, uint32_t rva)
+{
+	Pattern window;
+	if (!WindowAt(module, kind, rva, window))
+		return {};
+
+	size_t length = ShortestUniquePrefix(module.Regions(kind), window);
+	return length ? ToString(Prefix(window, length)) : std::string();
+}
+
+// Best of several runs, in milliseconds
+template <typename F>
+static double Time(int repeat, F f)
+{
+	double best = 1e30;
+	for (int i = 0; i < repeat; ++i)
+	{
+		auto start = std::chrono::steady_clock::now();
+		f();
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	int repeat = 1;
+	bool suggest = false;
+	std::vector<std::pair<std::string, uint32_t>> make;
+	std::vector<fs::path> dirs;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--repeat" && i + 1 < argc)
+			repeat = std::max(1, atoi(argv[++i]));
+		else if (arg == "--suggest")
+			suggest = true;
+		else if (arg == "--make" && i + 2 < argc)
+		{
+			make.emplace_back(argv[i + 1], (uint32_t)strtoul(argv[i + 2], nullptr, 16));
+			i += 2;
+		}
+		else
+			dirs.push_back(arg);
+	}
+
+	if (dirs.empty())
+	{
+		printf("Usage: %s [--repeat N] [--suggest] [--make <module> <rva>]... <bin dir> [more bin dirs...]\n", argv[0]);
+		return 2;
+	}
+
+	if (!make.empty())
+	{
+		int failed = 0;
+		for (const auto &[moduleName, rva] : make)
+		{
+			Module module;
+			std::string signature;
+			if (!module.Load(dirs, moduleName))
+				printf("%s: not found or not a PE file\n", moduleName.c_str());
+			else if ((signature = GenerateSignature(module, SectionKind::Code, rva)).empty())
+				printf("%s+0x%X: not in a code section or no unique signature within %zu bytes\n", moduleName.c_str(), rva, Pattern::MaxSize);
+			else
+			{
+				char name[16];
+				snprintf(name, sizeof(name), "sub_%X", rva);
+				PrintEntry(name, moduleName, rva, signature, 0);
+				continue;
+			}
+			++failed;
+		}
+		return failed ? 1 : 0;
+	}
+
+	std::map<std::string, std::vector<const Offset *>> modules;
+	for (const Offset *offset : OffsetTable::All)
+		modules[offset->moduleName].push_back(offset);
+
+	// Offsets reached from another offset come after their base
+	for (auto &[moduleName, offsets] : modules)
+		std::stable_sort(offsets.begin(), offsets.end(), [](const Offset *a, const Offset *b) { return Depth(*a) < Depth(*b); });
+
+	int missing = 0, moved = 0, ambiguous = 0;
+	double totalSingle = 0, totalBatch = 0;
+
+	for (auto &[moduleName, offsets] : modules)
+	{
+		Module module;
+		if (!module.Load(dirs, moduleName))
+		{
+			printf("%s: not found or not a PE file\n\n", moduleName.c_str());
+			missing += (int)offsets.size();
+			continue;
+		}
+
+		ModuleIdentity identity;
+		ModuleIdentity::FromImage(moduleName, module.pe, identity);
+
+		const auto &regions = module.regions;
+		size_t codeSize = 0;
+		for (const ImageRegion &region : module.Regions(SectionKind::Code))
+			codeSize += region.size;
+
+		printf("%s (%s)\n  timestamp %08X, SizeOfImage %u KB, code %zu KB, .text hash %016llX\n", moduleName.c_str(), module.path.string().c_str(),
+			identity.timeDateStamp, identity.sizeOfImage / 1024, codeSize / 1024, (unsigned long long)identity.textHash);
+		printf("  %-30s %10s %10s %7s %10s  %s\n", "name", "hardcoded", "resolved", "matches", "scan ms", "status");
+
+		double moduleSingle = 0;
+		std::vector<const Pattern *> patterns[3];
+		std::map<const Offset *, uint32_t> found;
+		for (const Offset *offset : offsets)
+		{
+			char resolved[16] = "-";
+			if (offset->base)
+			{
+				auto base = found.find(offset->base);
+				uint32_t rva;
+				if (base != found.end() && offset->Follow(module.pe, base->second, rva) < 0)
+				{
+					found[offset] = rva;
+					snprintf(resolved, sizeof(resolved), "0x%X", rva);
+				}
+				else
+				{
+					++missing;
+				}
+
+				printf("  %-30s %10s %10s %7s %10s  %s%s\n", offset->name, "-", resolved, "-", "-",
+					found.count(offset) ? "via " : "MISSING, via ", offset->base->name);
+				continue;
+			}
+
+			const std::vector<ImageRegion> &sections = regions[(size_t)offset->sections];
+			const Pattern &pattern = offset->signature.pattern;
+			patterns[(size_t)offset->sections].push_back(&pattern);
+
+			PatternMatches matches;
+			double ms = Time(repeat, [&] { matches = FindAll(sections, pattern); });
+			moduleSingle += ms;
+
+			const bool hardcodedValid = SigScanner::CheckOffset(sections, offset->offset, pattern, offset->sigOffset);
+			const char *status = "ok";
+			if (matches.count == 0)
+			{
+				status = "MISSING";
+				++missing;
+			}
+			else if (!hardcodedValid)
+			{
+				status = "moved";
+				++moved;
+			}
+
+			if (matches.count > 1)
+				++ambiguous;
+
+			// The resolve steps run from where the signature matched, a step that leaves the image
+			// counts as missing
+			uint32_t rva;
+			int failedStep = -1;
+			if (matches.count && (failedStep = offset->Follow(module.pe, (uint32_t)(matches.first + offset->sigOffset), rva)) < 0)
+			{
+				found[offset] = rva;
+				snprintf(resolved, sizeof(resolved), "0x%X", rva);
+			}
+			else if (matches.count)
+			{
+				status = "MISSING, steps leave the image";
+				++missing;
+			}
+
+			printf("  %-30s %#10x %10s %7d %10.3f  %s%s\n", offset->name, offset->offset, resolved, matches.count, ms, status,
+				matches.count > 1 ? ", ambiguous" : "");
+
+			if (suggest && matches.count)
+			{
+				// Regenerate at the hardcoded offset if it's still right, the first match may be another function
+				const uint32_t start = (uint32_t)(hardcodedValid ? offset->offset - offset->sigOffset : (int)matches.first);
+				const size_t unique = ShortestUniquePrefix(sections, pattern);
+				const std::string generated = GenerateSignature(module, offset->sections, start);
+
+				if (unique)
+					printf("    %zu bytes, unique after %zu\n", pattern.length, unique);
+				else
+					printf("    %zu bytes, not unique\n", pattern.length);
+
+				if (generated.empty())
+					printf("    no unique signature within %zu bytes\n", Pattern::MaxSize);
+				else
+					PrintEntry(offset->name, moduleName, start + offset->sigOffset, generated, offset->sigOffset, StepsText(*offset));
+			}
+		}
+
+		// Same signatures in a single multi-pattern pass per section kind, like Offsets does it
+		double moduleBatch = Time(repeat, [&]
+		{
+			for (size_t kind = 0; kind < std::size(regions); ++kind)
+			{
+				if (!patterns[kind].empty())
+					SigScanner::FindPatterns(regions[kind], patterns[kind]);
+			}
+		});
+
+		printf("  one scan per signature: %.3f ms, single pass: %.3f ms\n\n", moduleSingle, moduleBatch);
+		totalSingle += moduleSingle;
+		totalBatch += moduleBatch;
+	}
+
+	printf("%zu signatures: %d moved, %d missing, %d ambiguous\n", std::size(OffsetTable::All), moved, missing, ambiguous);
+	printf("one scan per signature: %.3f ms, single pass: %.3f ms, AVX2: %s\n", totalSingle, totalBatch, SigScanner::HasAVX2() ? "yes" : "no");
+	return missing ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+// sigbench.cpp : Benchmarks the signature scanner against synthetic module images.
+//
+// Build (Linux):   g++ -std=c++17 -O2 -I../L4D2VR sigbench.cpp -o sigbench
+// Build (Windows): cl /std:c++17 /O2 /EHsc /I..\L4D2VR sigbench.cpp
+//
+// Usage: sigbench [imageSizeMB] [seed]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "sigscanner.h"
+
+// A representative slice of the signatures in offsets.h: long/short, wildcard heavy and with
+// common prologue prefixes.
+static const char *g_Signatures[] = {
+	"A1 ? ? ? ? 85 C0 75 53 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? 6A 00 6A 01 68 ? ? ? ? 68 ? ? ? ? FF D2 50 B9 ? ? ? ? E8 ? ? ? ? 80 3D ? ? ? ? ? 75 1C 8B 0D ? ? ? ? 8B 01 8B 90 ? ? ? ? 68 ? ? ? ? C6 05 ? ? ? ? ? FF D2 A1 ? ? ? ? C3",
+	"55 8B EC 83 EC 2C 53 56 8B F1 6A 00 8D 8E ? ? ? ? E8 ? ? ? ?",
+	"55 8B EC 83 EC 34 53 8B D9 80 BB",
+	"55 8B EC A1 ? ? ? ? 83 EC 0C 83 78 30 00 56 8B 75 0C 57 8B F9 74 43",
+	"8B 41 1C 85 C0 75 01 C3 8B 0D ? ? ? ? 2B 41 58 C1 F8 04 C3 CC",
+	"56 8B F1 83 7E 4C 00",
+	"53 8B DC 83 EC 08 83 E4 F0 83 C4 04 55 8B 6B 04 89 6C 24 04 8B EC 81 EC ? ? ? ? 56 57 8B F9 89 7D EC E8 ? ? ? ?",
+	"57 8B F9 80 BF ? ? ? ? ? 74 04 32 C0 5F C3",
+	"55 8B EC 0F 57 C0 F3 0F 10 4D ? 81 EC ? ? ? ? 0F 2E C8 9F 57 8B F9 F6 C4 44 7A 12",
+	"8B 81 ? ? ? ? 83 F8 FF 74 23 8B 15 ? ? ? ?",
+};
+
+// Fills the image with bytes roughly following the distribution of x86 code, so the anchor
+// selection sees realistic candidate rates instead of uniform noise.
+static void FillImage(std::vector<uint8_t> &image, std::mt19937 &rng)
+{
+	static const uint8_t hotBytes[] = { 0x00, 0xFF, 0x8B, 0xCC, 0x89, 0x24, 0x04, 0x83, 0x08, 0x45, 0xE8, 0x0F, 0x85, 0x55, 0xEC, 0xC3 };
+	std::uniform_int_distribution<int> coin(0, 99);
+	std::uniform_int_distribution<int> hot(0, sizeof(hotBytes) - 1);
+	std::uniform_int_distribution<int> any(0, 255);
+
+	for (uint8_t &b : image)
+		b = coin(rng) < 45 ? hotBytes[hot(rng)] : (uint8_t)any(rng);
+}
+
+static void Plant(std::vector<uint8_t> &image, const Pattern &pattern, size_t at, std::mt19937 &rng)
+{
+	for (size_t i = 0; i < pattern.size(); ++i)
+		image[at + i] = pattern.mask[i] ? pattern.bytes[i] : (uint8_t)rng();
+}
+
+template <typename F>
+static double TimeScans(const char *name, const std::vector<uint8_t> &image, const std::vector<Pattern> &patterns,
+	const std::vector<size_t> &expected, F find)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	bool ok = true;
+	for (size_t i = 0; i < patterns.size(); ++i)
+		ok &= find(image.data(), image.size(), patterns[i], 0) == expected[i];
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	double mbPerSec = (image.size() / (1024.0 * 1024.0)) * patterns.size() / (elapsed.count() / 1000.0);
+	printf("%-8s %10.2f ms  %10.1f MB/s  %s\n", name, elapsed.count(), mbPerSec, ok ? "ok" : "MISMATCH");
+	return elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+	size_t sizeMB = argc > 1 ? strtoul(argv[1], NULL, 10) : 32;
+	unsigned seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+	std::mt19937 rng(seed);
+	std::vector<uint8_t> image(sizeMB * 1024 * 1024);
+	FillImage(image, rng);
+
+	std::vector<Pattern> patterns;
+	std::vector<size_t> expected;
+	for (const char *sig : g_Signatures)
+		patterns.push_back(Pattern::Parse(sig));
+
+	// Plant each signature in the back half of the image so every scan walks most of it.
+	std::uniform_int_distribution<size_t> where(image.size() / 2, image.size() - 256);
+	for (const Pattern &pattern : patterns)
+	{
+		size_t at = where(rng);
+		Plant(image, pattern, at, rng);
+		expected.push_back(at);
+	}
+
+	// A random earlier match would also be a correct answer, use the scalar scan as the reference.
+	for (size_t i = 0; i < patterns.size(); ++i)
+		expected[i] = SigScanner::FindPatternScalar(image.data(), image.size(), patterns[i]);
+
+	printf("image: %zu MB, %zu signatures, AVX2: %s\n", sizeMB, patterns.size(), SigScanner::HasAVX2() ? "yes" : "no");
+
+	double scalar = TimeScans("scalar", image, patterns, expected, SigScanner::FindPatternScalar);
+	double sse2 = TimeScans("sse2", image, patterns, expected, SigScanner::FindPatternSSE2);
+	printf("sse2 speedup: %.1fx\n", scalar / sse2);
+
+	if (SigScanner::HasAVX2())
+	{
+		double avx2 = TimeScans("avx2", image, patterns, expected, SigScanner::FindPatternAVX2);
+		printf("avx2 speedup: %.1fx\n", scalar / avx2);
+	}
+
+	return 0;
+}